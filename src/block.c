@@ -489,22 +489,29 @@ fill_edd(struct segoff_s edd, struct drive_s *drive_fl)
  * Disk driver dispatch
  ****************************************************************/
 
+// Record the end of each driver setup in the boot profile of parisc.
+#define BLOCK_SETUP(func) do {                  \
+        func();                                 \
+        if (CONFIG_PARISC)                      \
+            boot_milestone(#func);              \
+    } while (0)
+
 void
 block_setup(void)
 {
-    floppy_setup();
-    ata_setup();
-    ahci_setup();
-    sdcard_setup();
-    ramdisk_setup();
-    virtio_blk_setup();
-    virtio_scsi_setup();
-    lsi_scsi_setup();
-    esp_scsi_setup();
-    megasas_setup();
-    pvscsi_setup();
-    mpt_scsi_setup();
-    nvme_setup();
+    BLOCK_SETUP(floppy_setup);
+    BLOCK_SETUP(ata_setup);
+    BLOCK_SETUP(ahci_setup);
+    BLOCK_SETUP(sdcard_setup);
+    BLOCK_SETUP(ramdisk_setup);
+    BLOCK_SETUP(virtio_blk_setup);
+    BLOCK_SETUP(virtio_scsi_setup);
+    BLOCK_SETUP(lsi_scsi_setup);
+    BLOCK_SETUP(esp_scsi_setup);
+    BLOCK_SETUP(megasas_setup);
+    BLOCK_SETUP(pvscsi_setup);
+    BLOCK_SETUP(mpt_scsi_setup);
+    BLOCK_SETUP(nvme_setup);
 }
 
 // Fallback handler for command requests not implemented by drivers
@@ -604,6 +611,117 @@ process_op_16(struct disk_op_s *op)
     }
 }
 
+// Largest number of buffer segments which a driver executes in one
+// CMD_READV or CMD_WRITEV request.  0 if the driver does not execute
+// vectored requests itself.
+int
+disk_iov_max(struct drive_s *drive_fl)
+{
+    switch (drive_fl->type) {
+    case DTYPE_VIRTIO_BLK:
+        return VIRTIO_BLK_IOV_MAX;
+    case DTYPE_VIRTIO_SCSI:
+        return VIRTIO_SCSI_IOV_MAX;
+    case DTYPE_AHCI:
+        return AHCI_PRDT_MAX;
+    case DTYPE_LSI_SCSI:
+        return LSI_IOV_MAX;
+    case DTYPE_PVSCSI:
+        return PVSCSI_MAX_SG_ELEM;
+    case DTYPE_NVME:
+        // segments must be page aligned to share one PRP list
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Largest block count of one request which a driver executes.  ATA
+// moves up to 65536 sectors with one LBA48 command, the other drivers
+// keep the 16-bit count of the BIOS disk interface.
+u32
+disk_count_max(struct drive_s *drive_fl)
+{
+    switch (drive_fl->type) {
+    case DTYPE_ATA:
+        return ATA_LBA48_MAX_SECTORS;
+    default:
+        return 0xffff;
+    }
+}
+
+// Number of buffer segments of a read or write request.
+int
+disk_op_iovcnt(struct disk_op_s *op)
+{
+    if (!disk_op_vectored(op))
+        return 1;
+    struct disk_iovec_s *iov = op->buf_fl;
+    u32 blocks = 0;
+    int i;
+    for (i = 0; blocks < op->count; i++)
+        blocks += iov[i].count;
+    return i;
+}
+
+// Execute a vectored request as plain READ/WRITE requests.  Segments
+// which are adjacent in memory are merged into one request.
+int
+process_op_split(struct disk_op_s *op)
+{
+    ASSERT32FLAT();
+    struct disk_iovec_s *iov = op->buf_fl;
+    u32 blksize = op->drive_fl->blksize;
+    struct disk_op_s dop = *op;
+    dop.command = (op->command == CMD_READV ? CMD_READ : CMD_WRITE);
+
+    int ret = DISK_RET_SUCCESS;
+    u32 done = 0;
+    while (done < op->count) {
+        u32 count = iov->count;
+        dop.buf_fl = iov->buf_fl;
+        iov++;
+        while (done + count < op->count
+               && iov->buf_fl == dop.buf_fl + count * blksize) {
+            count += iov->count;
+            iov++;
+        }
+        dop.count = count;
+        dop.lba = op->lba + done;
+        ret = process_op(&dop);
+        done += dop.count;
+        if (ret)
+            break;
+    }
+    op->count = done;
+    return ret;
+}
+
+// Execute a READ or WRITE request which is larger than the driver takes
+// as a series of requests of at most disk_count_max() blocks.
+static int
+process_op_chunked(struct disk_op_s *op)
+{
+    ASSERT32FLAT();
+    u32 max = disk_count_max(op->drive_fl);
+    u32 blksize = op->drive_fl->blksize;
+    struct disk_op_s dop = *op;
+
+    int ret = DISK_RET_SUCCESS;
+    u32 done = 0;
+    while (done < op->count) {
+        dop.count = op->count - done < max ? op->count - done : max;
+        dop.buf_fl = op->buf_fl + done * blksize;
+        dop.lba = op->lba + done;
+        ret = process_op(&dop);
+        done += dop.count;
+        if (ret)
+            break;
+    }
+    op->count = done;
+    return ret;
+}
+
 // Execute a disk_op_s request.
 int
 process_op(struct disk_op_s *op)
@@ -612,9 +730,18 @@ process_op(struct disk_op_s *op)
             , op->drive_fl, (u32)op->lba, op->buf_fl
             , op->count, op->command);
 
+    // Vectored and oversized requests come from 32bit code only
+    if (!MODESEGMENT && disk_op_vectored(op)
+        && (!disk_iov_max(op->drive_fl)
+            || op->count > disk_count_max(op->drive_fl)))
+        return process_op_split(op);
+    if (!MODESEGMENT && (op->command == CMD_READ || op->command == CMD_WRITE)
+        && op->count > disk_count_max(op->drive_fl))
+        return process_op_chunked(op);
+
     int ret, origcount = op->count;
     /* Only x86 arch has problems with large reads/writes greater than 64kb */
-    if (CONFIG_X86 &&
+    if (CONFIG_X86 && !disk_op_vectored(op) &&
 	(origcount * GET_FLATPTR(op->drive_fl->blksize) > 64*1024)) {
         op->count = 0;
         return DISK_RET_EBOUNDARY;
@@ -12,7 +12,7 @@ struct disk_op_s {
     void *buf_fl;
     struct drive_s *drive_fl;
     u8 command;
-    u16 count;
+    u32 count;
     union {
         // Commands: READ, WRITE, VERIFY, SEEK, FORMAT
         u64 lba;
@@ -30,9 +30,36 @@ struct disk_op_s {
 #define CMD_VERIFY  0x04
 #define CMD_FORMAT  0x05
 #define CMD_SEEK    0x07
+#define CMD_READV   0x08
+#define CMD_WRITEV  0x09
 #define CMD_ISREADY 0x10
 #define CMD_SCSI    0x20
 
+// Buffer segment of a vectored request.  For CMD_READV and CMD_WRITEV
+// buf_fl points to an array of these whose block counts add up to
+// the 'count' of the request.
+struct disk_iovec_s {
+    void *buf_fl;
+    u32 count;
+};
+
+static inline int
+disk_op_vectored(struct disk_op_s *op)
+{
+    return op->command == CMD_READV || op->command == CMD_WRITEV;
+}
+
+// Return buffer segment 'i' of a read or write request.  Plain
+// requests have a single segment.
+static inline struct disk_iovec_s
+disk_op_iov(struct disk_op_s *op, int i)
+{
+    if (disk_op_vectored(op))
+        return ((struct disk_iovec_s *)op->buf_fl)[i];
+    struct disk_iovec_s iov = { op->buf_fl, op->count };
+    return iov;
+}
+
 
 /****************************************************************
  * Global storage
@@ -118,6 +145,10 @@ int fill_edd(struct segoff_s edd, struct drive_s *drive_fl);
 void block_setup(void);
 int default_process_op(struct disk_op_s *op);
 int process_op(struct disk_op_s *op);
+int disk_iov_max(struct drive_s *drive_fl);
+u32 disk_count_max(struct drive_s *drive_fl);
+int disk_op_iovcnt(struct disk_op_s *op);
+int process_op_split(struct disk_op_s *op);
 int create_bounce_buf(void);
 
 #endif // block.h
@@ -137,8 +137,8 @@ DECL_SEGFUNCS(SS)
 #define FLATPTR_TO_OFFSET(p) (((u32)(p)) & 0xf)
 #define MAKE_FLATPTR(seg,off) ((void*)(((u32)(seg)<<4)+(u32)(off)))
 #elif CONFIG_PARISC
-#define FLATPTR_TO_SEG(p) (((u32)(p)) >> 16)
-#define FLATPTR_TO_OFFSET(p) (((u32)(p)) & 0xffff)
+#define FLATPTR_TO_SEG(p) (((unsigned long)(p)) >> 16)
+#define FLATPTR_TO_OFFSET(p) (((unsigned long)(p)) & 0xffff)
 #define MAKE_FLATPTR(seg,off) ((void*)(unsigned long)(off))
 #endif
 
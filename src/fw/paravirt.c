@@ -238,13 +238,17 @@ qemu_cfg_dma_transfer(void *address, u32 length, u32 control)
 {
     QemuCfgDmaAccess access;
 
-    access.address = cpu_to_be64((u64)(u32)address);
+    access.address = cpu_to_be64((u64)(unsigned long)address);
     access.length = cpu_to_be32(length);
     access.control = cpu_to_be32(control);
 
     barrier();
 
-    outl(cpu_to_be32((u32)&access), PORT_QEMU_CFG_DMA_ADDR_LOW);
+    // The 64-bit PA-RISC firmware (and its stack) lives above 4GB
+    if (sizeof(void*) > sizeof(u32))
+        outl(cpu_to_be32((u64)(unsigned long)&access >> 32)
+             , PORT_QEMU_CFG_DMA_ADDR_HIGH);
+    outl(cpu_to_be32((unsigned long)&access), PORT_QEMU_CFG_DMA_ADDR_LOW);
 
     while(be32_to_cpu(access.control) & ~QEMU_CFG_DMA_CTL_ERROR) {
         yield();
@@ -34,10 +34,18 @@ static inline int runningOnKVM(void) {
 // Common paravirt ports.
 #define PORT_SMI_CMD                0x00b2
 #define PORT_SMI_STATUS             0x00b3
+#if CONFIG_PARISC
+#include "parisc/hppa_hardware.h" // QEMU_FW_CFG_IO_BASE
+#define PORT_QEMU_CFG_CTL           (QEMU_FW_CFG_IO_BASE + 0)
+#define PORT_QEMU_CFG_DATA          (QEMU_FW_CFG_IO_BASE + 4)
+#define PORT_QEMU_CFG_DMA_ADDR_HIGH (QEMU_FW_CFG_IO_BASE + 8)
+#define PORT_QEMU_CFG_DMA_ADDR_LOW  (QEMU_FW_CFG_IO_BASE + 12)
+#else
 #define PORT_QEMU_CFG_CTL           0x0510
 #define PORT_QEMU_CFG_DATA          0x0511
 #define PORT_QEMU_CFG_DMA_ADDR_HIGH 0x0514
 #define PORT_QEMU_CFG_DMA_ADDR_LOW  0x0518
+#endif
 
 // QEMU_CFG_DMA_CONTROL bits
 #define QEMU_CFG_DMA_CTL_ERROR   0x01
@@ -23,6 +23,7 @@
 #define AHCI_REQUEST_TIMEOUT 32000 // 32 seconds max for IDE ops
 #define AHCI_RESET_TIMEOUT     500 // 500 miliseconds
 #define AHCI_LINK_TIMEOUT       10 // 10 miliseconds
+#define AHCI_PRD_MAX_BYTES (4*1024*1024)
 
 // prepare sata command fis
 static void sata_prep_simple(struct sata_cmd_fis *fis, u8 command)
@@ -100,9 +101,9 @@ static void ahci_port_writel(struct ahci_ctrl_s *ctrl, u32 pnr, u32 reg, u32 val
     ahci_ctrl_writel(ctrl, ctrl_reg, val);
 }
 
-// submit ahci command + wait for result
-static int ahci_command(struct ahci_port_s *port_gf, int iswrite, int isatapi,
-                        void *buffer, u32 bsize)
+// submit ahci command with 'nprd' filled prd entries + wait for result
+static int ahci_command_prd(struct ahci_port_s *port_gf, int iswrite,
+                            int isatapi, int nprd)
 {
     u32 val, status, success, flags, intbits, error;
     struct ahci_ctrl_s *ctrl = port_gf->ctrl;
@@ -113,11 +114,8 @@ static int ahci_command(struct ahci_port_s *port_gf, int iswrite, int isatapi,
 
     cmd->fis.reg       = 0x27;
     cmd->fis.pmp_type  = 1 << 7; /* cmd fis */
-    cmd->prdt[0].base  = (u32)buffer;
-    cmd->prdt[0].baseu = 0;
-    cmd->prdt[0].flags = bsize-1;
 
-    flags = ((1 << 16) | /* one prd entry */
+    flags = ((nprd << 16) | /* prd entries */
              (iswrite ? (1 << 6) : 0) |
              (isatapi ? (1 << 5) : 0) |
              (5 << 0)); /* fis length (dwords) */
@@ -209,6 +207,35 @@ static int ahci_command(struct ahci_port_s *port_gf, int iswrite, int isatapi,
     return success ? 0 : -1;
 }
 
+// submit ahci command for a single buffer + wait for result
+static int ahci_command(struct ahci_port_s *port_gf, int iswrite, int isatapi,
+                        void *buffer, u32 bsize)
+{
+    struct ahci_cmd_s *cmd = port_gf->cmd;
+
+    cmd->prdt[0].base  = (u32)buffer;
+    cmd->prdt[0].baseu = 0;
+    cmd->prdt[0].flags = bsize-1;
+    return ahci_command_prd(port_gf, iswrite, isatapi, 1);
+}
+
+// Check that the prd table can take the buffers of a disk request
+static int ahci_prdt_fits(struct disk_op_s *op)
+{
+    int iovcnt = disk_op_iovcnt(op);
+    int i;
+
+    if (iovcnt > AHCI_PRDT_MAX)
+        return 0;
+    for (i = 0; i < iovcnt; i++) {
+        struct disk_iovec_s iov = disk_op_iov(op, i);
+        if (((u32)iov.buf_fl & 1)
+            || iov.count * DISK_SECTOR_SIZE > AHCI_PRD_MAX_BYTES)
+            return 0;
+    }
+    return 1;
+}
+
 #define CDROM_CDB_SIZE 12
 
 int ahci_atapi_process_op(struct disk_op_s *op)
@@ -232,18 +259,25 @@ int ahci_atapi_process_op(struct disk_op_s *op)
     return DISK_RET_SUCCESS;
 }
 
-// read/write count blocks from a harddrive, op->buf_fl must be word aligned
+// read/write count blocks from a harddrive, the buffers must pass
+// ahci_prdt_fits()
 static int
 ahci_disk_readwrite_aligned(struct disk_op_s *op, int iswrite)
 {
     struct ahci_port_s *port_gf = container_of(
         op->drive_fl, struct ahci_port_s, drive);
     struct ahci_cmd_s *cmd = port_gf->cmd;
-    int rc;
-
+    int iovcnt = disk_op_iovcnt(op);
+    int i, rc;
+
+    for (i = 0; i < iovcnt; i++) {
+        struct disk_iovec_s iov = disk_op_iov(op, i);
+        cmd->prdt[i].base  = (u32)iov.buf_fl;
+        cmd->prdt[i].baseu = 0;
+        cmd->prdt[i].flags = iov.count * DISK_SECTOR_SIZE - 1;
+    }
     sata_prep_readwrite(&cmd->fis, op, iswrite);
-    rc = ahci_command(port_gf, iswrite, 0, op->buf_fl,
-                      op->count * DISK_SECTOR_SIZE);
+    rc = ahci_command_prd(port_gf, iswrite, 0, iovcnt);
     dprintf(8, "ahci disk %s, lba %6x, count %3x, buf %p, rc %d\n",
             iswrite ? "write" : "read", (u32)op->lba, op->count, op->buf_fl, rc);
     if (rc < 0)
@@ -255,9 +289,11 @@ ahci_disk_readwrite_aligned(struct disk_op_s *op, int iswrite)
 static int
 ahci_disk_readwrite(struct disk_op_s *op, int iswrite)
 {
-    // if caller's buffer is word aligned, use it directly
-    if (((u32) op->buf_fl & 1) == 0)
+    // if caller's buffers are word aligned, use them directly
+    if (ahci_prdt_fits(op))
         return ahci_disk_readwrite_aligned(op, iswrite);
+    if (disk_op_vectored(op))
+        return process_op_split(op);
 
     // Use a word aligned buffer for AHCI I/O
     int rc;
@@ -300,8 +336,10 @@ ahci_process_op(struct disk_op_s *op)
         return 0;
     switch (op->command) {
     case CMD_READ:
+    case CMD_READV:
         return ahci_disk_readwrite(op, 0);
     case CMD_WRITE:
+    case CMD_WRITEV:
         return ahci_disk_readwrite(op, 1);
     default:
         return default_process_op(op);
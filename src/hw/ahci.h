@@ -81,6 +81,8 @@ struct ahci_port_s {
     int                prio;
 };
 
+#define AHCI_PRDT_MAX            8 // prd entries in the 256 byte command table
+
 void ahci_setup(void);
 int ahci_process_op(struct disk_op_s *op);
 int ahci_atapi_process_op(struct disk_op_s *op);
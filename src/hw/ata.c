@@ -24,6 +24,7 @@
 #include "x86.h" // inb
 
 #define IDE_TIMEOUT 32000 //32 seconds max for IDE ops
+#define ATA_MULTI_MAX 128 // largest DRQ block used with READ/WRITE MULTIPLE
 
 
 /****************************************************************
@@ -270,10 +271,45 @@ fail:
  * ATA PIO transfers
  ****************************************************************/
 
+// Data phase statistics of PIO transfers (parisc only).
+struct ata_pio_stats {
+    u32 sectors, bursts;
+    u64 bytes, ticks;
+};
+static struct ata_pio_stats AtaPioStats;
+
+// Per-word I/O in ata_pio_transfer() in place of the string I/O, which
+// keeps the Dino address latch over a block; set by ata_pio_bench() only.
+static int AtaPioUnlatched;
+
+// Move 'words' words with one inw()/outw() each.  On parisc every access
+// writes the Dino address latch again.
+static void
+ata_pio_words(portaddr_t iobase1, u16 *buf, int words, int iswrite)
+{
+    for (; words; words--, buf++)
+        if (iswrite)
+            outw(*buf, iobase1);
+        else
+            *buf = inw(iobase1);
+}
+
+void
+ata_show_stats(void)
+{
+    if (!CONFIG_PARISC || !AtaPioStats.sectors)
+        return;
+    u64 us = timer_ticks_to_us(AtaPioStats.ticks);
+    dprintf(1, "ata pio: sectors=%u bursts=%u bytes=%llu time=%llu us"
+            " rate=%llu KB/s\n"
+            , AtaPioStats.sectors, AtaPioStats.bursts, AtaPioStats.bytes, us
+            , us ? AtaPioStats.bytes * 1000000 / 1024 / us : 0);
+}
+
 // Transfer 'op->count' blocks (of 'blocksize' bytes) to/from drive
-// 'op->drive_fl'.
+// 'op->drive_fl'.  The drive raises DRQ once for every 'multi' blocks.
 static int
-ata_pio_transfer(struct disk_op_s *op, int iswrite, int blocksize)
+ata_pio_transfer(struct disk_op_s *op, int iswrite, int blocksize, int multi)
 {
     dprintf(16, "ata_pio_transfer id=%p write=%d count=%d bs=%d buf=%p\n"
             , op->drive_fl, iswrite, op->count, blocksize, op->buf_fl);
@@ -287,22 +323,35 @@ ata_pio_transfer(struct disk_op_s *op, int iswrite, int blocksize)
     void *buf_fl = op->buf_fl;
     int status;
     for (;;) {
-        if (iswrite) {
-            // Write data to controller
-            dprintf(16, "Write sector id=%p dest=%p\n", op->drive_fl, buf_fl);
-            if (CONFIG_ATA_PIO32)
-                outsl_fl(iobase1, buf_fl, blocksize / 4);
-            else
-                outsw_fl(iobase1, buf_fl, blocksize / 2);
-        } else {
-            // Read data from controller
-            dprintf(16, "Read sector id=%p dest=%p\n", op->drive_fl, buf_fl);
-            if (CONFIG_ATA_PIO32)
-                insl_fl(iobase1, buf_fl, blocksize / 4);
-            else
-                insw_fl(iobase1, buf_fl, blocksize / 2);
+        u64 start = CONFIG_PARISC ? timer_read64() : 0;
+        int burst = count < multi ? count : multi;
+        int i;
+        for (i = 0; i < burst; i++) {
+            if (CONFIG_PARISC_SELFTEST && AtaPioUnlatched) {
+                ata_pio_words(iobase1, buf_fl, blocksize / 2, iswrite);
+            } else if (iswrite) {
+                // Write data to controller
+                dprintf(16, "Write sector id=%p dest=%p\n", op->drive_fl, buf_fl);
+                if (CONFIG_ATA_PIO32)
+                    outsl_fl(iobase1, buf_fl, blocksize / 4);
+                else
+                    outsw_fl(iobase1, buf_fl, blocksize / 2);
+            } else {
+                // Read data from controller
+                dprintf(16, "Read sector id=%p dest=%p\n", op->drive_fl, buf_fl);
+                if (CONFIG_ATA_PIO32)
+                    insl_fl(iobase1, buf_fl, blocksize / 4);
+                else
+                    insw_fl(iobase1, buf_fl, blocksize / 2);
+            }
+            buf_fl += blocksize;
+        }
+        if (CONFIG_PARISC) {
+            AtaPioStats.ticks += timer_read64() - start;
+            AtaPioStats.bytes += burst * blocksize;
+            AtaPioStats.sectors += burst;
+            AtaPioStats.bursts++;
         }
-        buf_fl += blocksize;
 
         status = pause_await_not_bsy(iobase1, iobase2);
         if (status < 0) {
@@ -311,7 +360,7 @@ ata_pio_transfer(struct disk_op_s *op, int iswrite, int blocksize)
             return status;
         }
 
-        count--;
+        count -= burst;
         if (!count)
             break;
         status &= (ATA_CB_STAT_BSY | ATA_CB_STAT_DRQ | ATA_CB_STAT_ERR);
@@ -354,14 +403,24 @@ struct sff_dma_prd {
     u32 count;
 };
 
+// PRD table of the parisc firmware, aligned so it never crosses 64K.
+static struct sff_dma_prd AtaPrdTable[16] __aligned(128);
+
+// Write back (and on parisc invalidate) the cached lines of a DMA buffer.
+static void
+ata_dma_sync(void *buf_fl, u32 bytes)
+{
+    if (CONFIG_PARISC)
+        flush_data_cache(buf_fl, bytes);
+}
+
 // Check if DMA available and setup transfer if so.
 static int
 ata_try_dma(struct disk_op_s *op, int iswrite, int blocksize)
 {
     if (! CONFIG_ATA_DMA)
         return -1;
-    ASSERT16(); // behind ATA_DMA, needed on parisc to boot via ata
-    u32 dest = (u32)op->buf_fl;
+    u32 dest = (u32)(unsigned long)op->buf_fl;
     if (dest & 1)
         // Need minimum alignment of 1.
         return -1;
@@ -376,7 +435,13 @@ ata_try_dma(struct disk_op_s *op, int iswrite, int blocksize)
         return -1;
 
     // Build PRD dma structure.
-    struct sff_dma_prd *dma = MAKE_FLATPTR(SEG_LOW, ExtraStack);
+    struct sff_dma_prd *dma;
+    if (CONFIG_PARISC) {
+        dma = AtaPrdTable;
+    } else {
+        ASSERT16();
+        dma = MAKE_FLATPTR(SEG_LOW, ExtraStack);
+    }
     struct sff_dma_prd *origdma = dma;
     while (bytes) {
         if (dma >= &origdma[16])
@@ -387,19 +452,24 @@ ata_try_dma(struct disk_op_s *op, int iswrite, int blocksize)
         if (count > max)
             count = max;
 
-        SET_LOWFLAT(dma->buf_fl, dest);
+        // The controller reads the table in PCI (little endian) order.
+        SET_LOWFLAT(dma->buf_fl, cpu_to_le32(dest));
         bytes -= count;
         if (!bytes)
             // Last descriptor.
             count |= 1<<31;
         dprintf(16, "dma@%p: %08x %08x\n", dma, dest, count);
         dest += count;
-        SET_LOWFLAT(dma->count, count);
+        SET_LOWFLAT(dma->count, cpu_to_le32(count));
         dma++;
     }
 
+    // No dirty lines may be written back over the buffer during the DMA.
+    ata_dma_sync(op->buf_fl, op->count * blocksize);
+    ata_dma_sync(origdma, (void*)dma - (void*)origdma);
+
     // Program bus-master controller.
-    outl((u32)origdma, iomaster + BM_TABLE);
+    outl((u32)(unsigned long)origdma, iomaster + BM_TABLE);
     u8 oldcmd = inb(iomaster + BM_CMD) & ~(BM_CMD_MEMWRITE|BM_CMD_START);
     outb(oldcmd | (iswrite ? 0x00 : BM_CMD_MEMWRITE), iomaster + BM_CMD);
     outb(BM_STATUS_ERROR|BM_STATUS_IRQ, iomaster + BM_STATUS);
@@ -409,7 +479,7 @@ ata_try_dma(struct disk_op_s *op, int iswrite, int blocksize)
 
 // Transfer data using DMA.
 static int
-ata_dma_transfer(struct disk_op_s *op)
+ata_dma_transfer(struct disk_op_s *op, int blocksize)
 {
     if (! CONFIG_ATA_DMA)
         return -1;
@@ -444,6 +514,9 @@ ata_dma_transfer(struct disk_op_s *op)
     portaddr_t iobase2 = GET_GLOBALFLAT(chan_gf->iobase2);
     int idestatus = pause_await_not_bsy(iobase1, iobase2);
 
+    // Drop lines the CPU may have fetched while the device wrote memory.
+    ata_dma_sync(op->buf_fl, op->count * blocksize);
+
     if ((status & (BM_STATUS_IRQ|BM_STATUS_ACTIVE)) == BM_STATUS_IRQ
         && idestatus >= 0x00
         && (idestatus & (ATA_CB_STAT_BSY | ATA_CB_STAT_DF | ATA_CB_STAT_DRQ
@@ -480,7 +553,8 @@ ata_pio_cmd_data(struct disk_op_s *op, int iswrite, struct ata_pio_command *cmd)
     ret = ata_wait_data(iobase1);
     if (ret)
         goto fail;
-    ret = ata_pio_transfer(op, iswrite, DISK_SECTOR_SIZE);
+    int multi = GET_GLOBALFLAT(adrive_gf->multi);
+    ret = ata_pio_transfer(op, iswrite, DISK_SECTOR_SIZE, multi ? multi : 1);
 
 fail:
     // Enable interrupts
@@ -488,6 +562,64 @@ fail:
     return ret;
 }
 
+#define ATA_BENCH_SECTORS 64
+
+// Read the first sectors of 'drive_fl' with the latched string I/O and
+// again with per-word I/O, and compare the data phase rates.
+void
+ata_pio_bench(struct drive_s *drive_fl)
+{
+    if (!CONFIG_PARISC_SELFTEST || !drive_fl
+        || GET_GLOBALFLAT(drive_fl->type) != DTYPE_ATA)
+        return;
+    u32 bytes = ATA_BENCH_SECTORS * DISK_SECTOR_SIZE;
+    u8 *buf = malloc_tmphigh(2 * bytes);
+    if (!buf) {
+        warn_noalloc();
+        return;
+    }
+    struct atadrive_s *adrive_gf = container_of(
+        drive_fl, struct atadrive_s, drive);
+    int multi = GET_GLOBALFLAT(adrive_gf->multi);
+    struct ata_pio_stats saved = AtaPioStats;
+    u64 ticks[2];
+    int pass, ret = 0;
+    for (pass = 0; pass < 2 && !ret; pass++) {
+        struct disk_op_s dop;
+        memset(&dop, 0, sizeof(dop));
+        dop.drive_fl = drive_fl;
+        dop.command = CMD_READ;
+        dop.count = ATA_BENCH_SECTORS;
+        dop.buf_fl = buf + pass * bytes;
+        struct ata_pio_command cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.command = multi ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ_SECTORS;
+        cmd.sector_count = ATA_BENCH_SECTORS;
+        cmd.device = ATA_CB_DH_LBA;
+
+        AtaPioStats.ticks = 0;
+        AtaPioUnlatched = pass;
+        ret = ata_pio_cmd_data(&dop, 0, &cmd);
+        AtaPioUnlatched = 0;
+        ticks[pass] = AtaPioStats.ticks;
+    }
+    AtaPioStats = saved;
+
+    if (ret) {
+        dprintf(1, "ata pio bench: read failed (%d)\n", ret);
+    } else {
+        u64 us0 = timer_ticks_to_us(ticks[0]) ?: 1;
+        u64 us1 = timer_ticks_to_us(ticks[1]) ?: 1;
+        dprintf(1, "ata pio bench: %d sectors latched %llu us (%llu KB/s)"
+                ", per word %llu us (%llu KB/s), speedup %llu.%02llu%s\n"
+                , ATA_BENCH_SECTORS, us0, (u64)bytes * 1000000 / 1024 / us0
+                , us1, (u64)bytes * 1000000 / 1024 / us1
+                , us1 / us0, us1 * 100 / us0 % 100
+                , memcmp(buf, buf + bytes, bytes) ? ", DATA MISMATCH" : "");
+    }
+    free(buf);
+}
+
 // Transfer data to harddrive using DMA protocol.
 static int
 ata_dma_cmd_data(struct disk_op_s *op, struct ata_pio_command *cmd)
@@ -499,7 +631,7 @@ ata_dma_cmd_data(struct disk_op_s *op, struct ata_pio_command *cmd)
     int ret = send_cmd(adrive_gf, cmd);
     if (ret)
         return ret;
-    return ata_dma_transfer(op);
+    return ata_dma_transfer(op, DISK_SECTOR_SIZE);
 }
 
 // Read/write count blocks from a harddrive.
@@ -509,25 +641,35 @@ ata_readwrite(struct disk_op_s *op, int iswrite)
     u64 lba = op->lba;
 
     int usepio = ata_try_dma(op, iswrite, DISK_SECTOR_SIZE);
+    struct atadrive_s *adrive_gf = container_of(
+        op->drive_fl, struct atadrive_s, drive);
+    int multi = GET_GLOBALFLAT(adrive_gf->multi);
 
     struct ata_pio_command cmd;
     memset(&cmd, 0, sizeof(cmd));
 
     if (op->count >= (1<<8) || lba + op->count >= (1<<28)) {
+        // A count of ATA_LBA48_MAX_SECTORS is sent as 0 in both halves.
         cmd.sector_count2 = op->count >> 8;
         cmd.lba_low2 = lba >> 24;
         cmd.lba_mid2 = lba >> 32;
         cmd.lba_high2 = lba >> 40;
         lba &= 0xffffff;
 
-        if (usepio)
+        if (usepio && multi)
+            cmd.command = (iswrite ? ATA_CMD_WRITE_MULTIPLE_EXT
+                           : ATA_CMD_READ_MULTIPLE_EXT);
+        else if (usepio)
             cmd.command = (iswrite ? ATA_CMD_WRITE_SECTORS_EXT
                            : ATA_CMD_READ_SECTORS_EXT);
         else
             cmd.command = (iswrite ? ATA_CMD_WRITE_DMA_EXT
                            : ATA_CMD_READ_DMA_EXT);
     } else {
-        if (usepio)
+        if (usepio && multi)
+            cmd.command = (iswrite ? ATA_CMD_WRITE_MULTIPLE
+                           : ATA_CMD_READ_MULTIPLE);
+        else if (usepio)
             cmd.command = (iswrite ? ATA_CMD_WRITE_SECTORS
                            : ATA_CMD_READ_SECTORS);
         else
@@ -602,8 +744,14 @@ ata_atapi_process_op(struct disk_op_s *op)
     portaddr_t iobase1 = GET_GLOBALFLAT(chan_gf->iobase1);
     portaddr_t iobase2 = GET_GLOBALFLAT(chan_gf->iobase2);
 
+    // Only data reads are worth a bus-master transfer.
+    int usepio = (op->command != CMD_READ
+                  || ata_try_dma(op, 0, blocksize));
+
     struct ata_pio_command cmd;
     memset(&cmd, 0, sizeof(cmd));
+    if (!usepio)
+        cmd.feature = 0x01; // DMA
     cmd.lba_mid = blocksize;
     cmd.lba_high = blocksize >> 8;
     cmd.command = ATA_CMD_PACKET;
@@ -621,6 +769,11 @@ ata_atapi_process_op(struct disk_op_s *op)
     // Send command to device
     outsw_fl(iobase1, MAKE_FLATPTR(GET_SEG(SS), cdbcmd), CDROM_CDB_SIZE / 2);
 
+    if (!usepio) {
+        ret = ata_dma_transfer(op, blocksize);
+        goto fail;
+    }
+
     int status = pause_await_not_bsy(iobase1, iobase2);
     if (status < 0) {
         ret = status;
@@ -643,7 +796,7 @@ ata_atapi_process_op(struct disk_op_s *op)
             goto fail;
         }
 
-        ret = ata_pio_transfer(op, 0, blocksize);
+        ret = ata_pio_transfer(op, 0, blocksize, 1);
     }
 
 fail:
@@ -761,6 +914,30 @@ init_drive_atapi(struct atadrive_s *dummy, u16 *buffer)
     return adrive;
 }
 
+// Enable READ/WRITE MULTIPLE with the largest DRQ block the drive offers.
+static void
+ata_set_multiple(struct atadrive_s *adrive, u16 *buffer)
+{
+    u16 maxmulti = le16_to_cpu(buffer[47]); // word 47 - max sectors per DRQ
+    if ((maxmulti & 0xff00) != 0x8000 || !(maxmulti & 0xff))
+        return;
+    int multi = ATA_MULTI_MAX;
+    while (multi > (maxmulti & 0xff))
+        multi >>= 1;
+    if (multi < 2)
+        return;
+
+    struct ata_pio_command cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.command = ATA_CMD_SET_MULTIPLE_MODE;
+    cmd.sector_count = multi;
+    int ret = ata_cmd_nondata(adrive, &cmd);
+    dprintf(3, "ata%d-%d: multiple mode %d sectors (ret=%d)\n"
+            , adrive->chan_gf->ataid, adrive->slave, multi, ret);
+    if (!ret)
+        adrive->multi = multi;
+}
+
 // Detect if the given drive is a regular ata drive - initialize it if so.
 static struct atadrive_s *
 init_drive_ata(struct atadrive_s *dummy, u16 *buffer)
@@ -787,6 +964,7 @@ init_drive_ata(struct atadrive_s *dummy, u16 *buffer)
     else
         sectors = le32_to_cpu(*(u32*)&buffer[60]); // word 60 and word 61
     adrive->drive.sectors = sectors;
+    ata_set_multiple(adrive, buffer);
     u64 adjsize = sectors >> 11;
     char adjprefix = 'M';
     if (adjsize >= (1 << 16)) {
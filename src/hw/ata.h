@@ -20,14 +20,20 @@ struct atadrive_s {
     struct drive_s drive;
     struct ata_channel_s *chan_gf;
     u8 slave;
+    u8 multi;   // sectors per DRQ block, 0 if multiple mode is off
 };
 
+// Largest sector count of one LBA48 command; it is sent as 0.
+#define ATA_LBA48_MAX_SECTORS 65536
+
 // ata.c
 char *ata_extract_model(char *model, u32 size, u16 *buffer);
 int ata_extract_version(u16 *buffer);
 int ata_process_op(struct disk_op_s *op);
 int ata_atapi_process_op(struct disk_op_s *op);
 void ata_setup(void);
+void ata_show_stats(void);
+void ata_pio_bench(struct drive_s *drive_fl);
 
 #if CONFIG_X86
 #define PORT_ATA2_CMD_BASE     0x0170
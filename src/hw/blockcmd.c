@@ -113,10 +113,12 @@ scsi_fill_cmd(struct disk_op_s *op, void *cdbcmd, int maxcdb)
 
     switch (op->command) {
     case CMD_READ:
-    case CMD_WRITE: ;
+    case CMD_WRITE:
+    case CMD_READV:
+    case CMD_WRITEV: ;
         memset(cdbcmd, 0, maxcdb);
         memset(&cmd, 0, sizeof(cmd));
-        cmd.command = (op->command == CMD_READ ? CDB_CMD_READ_10
+        cmd.command = (scsi_is_read(op) ? CDB_CMD_READ_10
                         : CDB_CMD_WRITE_10);
         cmd.lba = cpu_to_be32(op->lba);
         cmd.count = cpu_to_be16(op->count);
@@ -136,7 +138,7 @@ scsi_fill_cmd(struct disk_op_s *op, void *cdbcmd, int maxcdb)
 int
 scsi_is_read(struct disk_op_s *op)
 {
-    return op->command == CMD_READ || (
+    return op->command == CMD_READ || op->command == CMD_READV || (
         !MODESEGMENT && op->command == CMD_SCSI && op->blocksize);
 }
 
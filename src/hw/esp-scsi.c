@@ -20,6 +20,7 @@
 #include "pcidevice.h" // foreachpci
 #include "pci_ids.h" // PCI_DEVICE_ID
 #include "pci_regs.h" // PCI_VENDOR_ID
+#include "pollwait.h" // pollwait_step
 #include "stacks.h" // run_thread
 #include "std/disk.h" // DISK_RET_SUCCESS
 #include "string.h" // memset
@@ -66,6 +67,8 @@ struct esp_lun_s {
     u8 lun;
 };
 
+DECLARE_POLLWAIT_STATS(esp_pollwait, "esp-scsi");
+
 static void
 esp_scsi_dma(u32 iobase, u32 buf, u32 len, int read)
 {
@@ -109,6 +112,8 @@ esp_scsi_process_op(struct disk_op_s *op)
         outb(cdbcmd[i], iobase + ESP_FIFO);
     outb(ESP_CMD_SELATN, iobase + ESP_CMD);
 
+    struct pollwait_s pw;
+    pollwait_init(&pw, &esp_pollwait);
     for (state = 0;;) {
         u8 stat = inb(iobase + ESP_RSTAT);
 
@@ -143,8 +148,9 @@ esp_scsi_process_op(struct disk_op_s *op)
             inb(iobase + ESP_FIFO);
             break;
         }
-        usleep(5);
+        pollwait_step(&pw);
     }
+    pollwait_done(&pw);
 
     if (status == 0) {
         return DISK_RET_SUCCESS;
@@ -16,11 +16,13 @@
 #include "config.h" // CONFIG_*
 #include "byteorder.h" // cpu_to_*
 #include "fw/paravirt.h" // runningOnQEMU
+#include "lsi-scsi.h" // LSI_IOV_MAX
 #include "malloc.h" // free
 #include "output.h" // dprintf
 #include "pcidevice.h" // foreachpci
 #include "pci_ids.h" // PCI_DEVICE_ID_VIRTIO_BLK
 #include "pci_regs.h" // PCI_VENDOR_ID
+#include "pollwait.h" // pollwait_step
 #include "stacks.h" // run_thread
 #include "std/disk.h" // DISK_RET_SUCCESS
 #include "string.h" // memset
@@ -44,6 +46,8 @@
 #define LSI_ISTAT0_SRST   0x40
 #define LSI_ISTAT0_ABRT   0x80
 
+#define LSI_SCRIPT_DMA    14    // script index of the first data move
+
 struct lsi_lun_s {
     struct drive_s drive;
     struct pci_device *pci;
@@ -52,6 +56,8 @@ struct lsi_lun_s {
     u8 lun;
 };
 
+DECLARE_POLLWAIT_STATS(lsi_pollwait, "lsi-scsi");
+
 int
 lsi_scsi_process_op(struct disk_op_s *op)
 {
@@ -65,9 +71,11 @@ lsi_scsi_process_op(struct disk_op_s *op)
     int blocksize = scsi_fill_cmd(op, cdbcmd, sizeof(cdbcmd));
     if (blocksize < 0)
         return default_process_op(op);
+    int iovcnt = disk_op_iovcnt(op);
+    if (!MODESEGMENT && iovcnt > LSI_IOV_MAX)
+        return process_op_split(op);
     u32 iobase = GET_GLOBALFLAT(llun_gf->iobase);
-    u32 dma = ((scsi_is_read(op) ? 0x01000000 : 0x00000000) |
-               (op->count * blocksize));
+    u32 dma = scsi_is_read(op) ? 0x01000000 : 0x00000000;
     u8 msgout[] = {
         0x80 | lun,                 // select lun
         0x08,
@@ -95,9 +103,8 @@ lsi_scsi_process_op(struct disk_op_s *op)
         0x07000002,                 // msgin
         (u32)MAKE_FLATPTR(GET_SEG(SS), &msgin_tmp),
 
-        /* dma data, get status, raise irq */
-        dma,                        // dma data
-        (u32)op->buf_fl,
+        /* dma data (one move per buffer segment), get status, raise irq */
+        [LSI_SCRIPT_DMA ... LSI_SCRIPT_DMA + 2*LSI_IOV_MAX - 1] = 0,
         0x03000001,                 // status
         (u32)MAKE_FLATPTR(GET_SEG(SS), &status),
         0x07000001,                 // msgin
@@ -105,6 +112,18 @@ lsi_scsi_process_op(struct disk_op_s *op)
         0x98080000,                 // dma irq
         0x00000000,
     };
+    int i;
+    for (i = 0; i < LSI_IOV_MAX; i++) {
+        u32 *move = &script[LSI_SCRIPT_DMA + 2*i];
+        if (i < iovcnt) {
+            struct disk_iovec_s iov = disk_op_iov(op, i);
+            move[0] = dma | (iov.count * blocksize);
+            move[1] = (u32)iov.buf_fl;
+        } else {
+            move[0] = 0x80880000;   // jump to next (nop)
+            move[1] = 0x00000000;
+        }
+    }
     u32 dsp = (u32)MAKE_FLATPTR(GET_SEG(SS), &script);
 
     /* convert to little endian for PCI */
@@ -115,18 +134,22 @@ lsi_scsi_process_op(struct disk_op_s *op)
     outb((dsp >> 16) & 0xff, iobase + LSI_REG_DSP2);
     outb((dsp >> 24) & 0xff, iobase + LSI_REG_DSP3);
 
+    struct pollwait_s pw;
+    pollwait_init(&pw, &lsi_pollwait);
     for (;;) {
         u8 dstat = inb(iobase + LSI_REG_DSTAT);
         u8 sist0 = inb(iobase + LSI_REG_SIST0);
         u8 sist1 = inb(iobase + LSI_REG_SIST1);
         if (sist0 || sist1) {
+            pollwait_done(&pw);
             goto fail;
         }
         if (dstat & 0x04) {
             break;
         }
-        usleep(5);
+        pollwait_step(&pw);
     }
+    pollwait_done(&pw);
 
     if (msgin == 0 && status == 0) {
         return DISK_RET_SUCCESS;
@@ -149,18 +172,21 @@ lsi_scsi_init_lun(struct lsi_lun_s *llun, struct pci_device *pci, u32 iobase,
     llun->iobase = iobase;
 }
 
-static int
-lsi_scsi_add_lun(u32 lun, struct drive_s *tmpl_drv)
+// LUN that was already set up by lsi_scsi_probe_lun().
+static struct {
+    struct pci_device *pci;
+    u8 target, lun;
+} LsiProbedLun;
+
+static struct drive_s *
+lsi_scsi_setup_lun(struct pci_device *pci, u32 iobase, u8 target, u8 lun)
 {
-    struct lsi_lun_s *tmpl_llun =
-        container_of(tmpl_drv, struct lsi_lun_s, drive);
     struct lsi_lun_s *llun = malloc_fseg(sizeof(*llun));
     if (!llun) {
         warn_noalloc();
-        return -1;
+        return NULL;
     }
-    lsi_scsi_init_lun(llun, tmpl_llun->pci, tmpl_llun->iobase,
-                      tmpl_llun->target, lun);
+    lsi_scsi_init_lun(llun, pci, iobase, target, lun);
 
     char *name = znprintf(MAXDESCSIZE, "lsi %pP %d:%d",
                           llun->pci, llun->target, llun->lun);
@@ -169,11 +195,27 @@ lsi_scsi_add_lun(u32 lun, struct drive_s *tmpl_drv)
     free(name);
     if (ret)
         goto fail;
-    return 0;
+    return &llun->drive;
 
 fail:
     free(llun);
-    return -1;
+    return NULL;
+}
+
+static int
+lsi_scsi_add_lun(u32 lun, struct drive_s *tmpl_drv)
+{
+    struct lsi_lun_s *tmpl_llun =
+        container_of(tmpl_drv, struct lsi_lun_s, drive);
+    if (LsiProbedLun.pci == tmpl_llun->pci
+        && LsiProbedLun.target == tmpl_llun->target
+        && LsiProbedLun.lun == lun)
+        // Registered already, don't add a second boot entry.
+        return 0;
+    if (!lsi_scsi_setup_lun(tmpl_llun->pci, tmpl_llun->iobase,
+                            tmpl_llun->target, lun))
+        return -1;
+    return 0;
 }
 
 static void
@@ -187,19 +229,28 @@ lsi_scsi_scan_target(struct pci_device *pci, u32 iobase, u8 target)
         scsi_sequential_scan(&llun0.drive, 8, lsi_scsi_add_lun);
 }
 
-static void
-init_lsi_scsi(void *data)
+static u32
+lsi_scsi_enable(struct pci_device *pci)
 {
-    struct pci_device *pci = data;
     u32 iobase = pci_enable_iobar(pci, PCI_BASE_ADDRESS_0);
     if (!iobase)
-        return;
+        return 0;
     pci_enable_busmaster(pci);
 
     dprintf(1, "found lsi53c895a at %pP, io @ %x\n", pci, iobase);
 
     // reset
     outb(LSI_ISTAT0_SRST, iobase + LSI_REG_ISTAT0);
+    return iobase;
+}
+
+static void
+init_lsi_scsi(void *data)
+{
+    struct pci_device *pci = data;
+    u32 iobase = lsi_scsi_enable(pci);
+    if (!iobase)
+        return;
 
     int i;
     for (i = 0; i < 7; i++)
@@ -223,3 +274,26 @@ lsi_scsi_setup(void)
         run_thread(init_lsi_scsi, pci);
     }
 }
+
+// Set up a single LUN without scanning the rest of the bus (fast boot).
+struct drive_s *
+lsi_scsi_probe_lun(struct pci_device *pci, u8 target, u8 lun)
+{
+    ASSERT32FLAT();
+    if (!CONFIG_LSI_SCSI || !runningOnQEMU())
+        return NULL;
+    if (pci->vendor != PCI_VENDOR_ID_LSI_LOGIC
+        || pci->device != PCI_DEVICE_ID_LSI_53C895A || target >= 7)
+        return NULL;
+
+    u32 iobase = lsi_scsi_enable(pci);
+    if (!iobase)
+        return NULL;
+    struct drive_s *drive = lsi_scsi_setup_lun(pci, iobase, target, lun);
+    if (drive) {
+        LsiProbedLun.pci = pci;
+        LsiProbedLun.target = target;
+        LsiProbedLun.lun = lun;
+    }
+    return drive;
+}
@@ -1,8 +1,13 @@
 #ifndef __LSI_SCSI_H
 #define __LSI_SCSI_H
 
+#define LSI_IOV_MAX       8     // data moves in the request script
+
 struct disk_op_s;
+struct drive_s;
+struct pci_device;
 int lsi_scsi_process_op(struct disk_op_s *op);
 void lsi_scsi_setup(void);
+struct drive_s *lsi_scsi_probe_lun(struct pci_device *pci, u8 target, u8 lun);
 
 #endif /* __LSI_SCSI_H */
@@ -103,6 +103,8 @@ struct nvme_ctrl {
     u32 ns_count;
     struct nvme_namespace *ns;
 
+    u32 max_prp;                /* most pages in one transfer */
+
     struct nvme_sq io_sq;
     struct nvme_cq io_cq;
 };
@@ -120,6 +122,9 @@ struct nvme_namespace {
 
     /* Page aligned buffer of size NVME_PAGE_SIZE. */
     char *dma_buffer;
+
+    /* Page aligned PRP list of NVME_PRP_MAX entries. */
+    u64 *prp_list;
 };
 
 /* Data structures for NVMe admin identify commands */
@@ -131,7 +136,12 @@ struct nvme_identify_ctrl {
     char mn[40];
     char fr[8];
 
-    char _boring[516 - 72];
+    u8 rab;
+    u8 ieee[3];
+    u8 cmic;
+    u8 mdts;                    /* max data transfer size, 2^n pages */
+
+    char _boring[516 - 78];
 
     u32 nn;                     /* number of namespaces */
 };
@@ -189,6 +199,7 @@ union nvme_identify {
 #define NVME_CQE_DW3_P (1U << 16)
 
 #define NVME_PAGE_SIZE 4096
+#define NVME_PRP_MAX (NVME_PAGE_SIZE / sizeof(u64))
 
 /* Length for the queue entries. */
 #define NVME_SQE_SIZE_LOG 6
@@ -11,6 +11,7 @@
 #include "pci_ids.h" // PCI_CLASS_STORAGE_NVME
 #include "pci_regs.h" // PCI_BASE_ADDRESS_0
 #include "pcidevice.h" // foreachpci
+#include "pollwait.h" // pollwait_step
 #include "stacks.h" // yield
 #include "std/disk.h" // DISK_RET_
 #include "string.h" // memset
@@ -20,6 +21,8 @@
 #include "nvme.h"
 #include "nvme-int.h"
 
+DECLARE_POLLWAIT_STATS(nvme_pollwait, "nvme");
+
 static void *
 zalloc_page_aligned(struct zone_s *zone, u32 size)
 {
@@ -137,14 +140,18 @@ nvme_wait(struct nvme_sq *sq)
 {
     static const unsigned nvme_timeout = 5000 /* ms */;
     u32 to = timer_calc(nvme_timeout);
+    struct pollwait_s pw;
+    pollwait_init(&pw, &nvme_pollwait);
     while (!nvme_poll_cq(sq->cq)) {
-        yield();
+        pollwait_step(&pw);
 
         if (timer_check(to)) {
             warn_timeout();
+            pollwait_timeout(&pw);
             return nvme_error_cqe();
         }
     }
+    pollwait_done(&pw);
 
     return nvme_consume_cqe(sq);
 }
@@ -282,6 +289,7 @@ nvme_probe_ns(struct nvme_ctrl *ctrl, struct nvme_namespace *ns, u32 ns_id)
     ns->drive.sectors   = ns->lba_count;
 
     ns->dma_buffer = zalloc_page_aligned(&ZoneHigh, NVME_PAGE_SIZE);
+    ns->prp_list = zalloc_page_aligned(&ZoneHigh, NVME_PAGE_SIZE);
 
     char *desc = znprintf(MAXDESCSIZE, "NVMe NS %u: %llu MiB (%llu %u-byte "
                           "blocks + %u-byte metadata)\n",
@@ -401,26 +409,18 @@ err:
     return -1;
 }
 
-/* Reads count sectors into buf. Returns DISK_RET_*. The buffer cannot cross
-   page boundaries. */
+/* Reads or writes count sectors at lba with the data pointers prp1 and prp2.
+   Returns DISK_RET_*. */
 static int
-nvme_io_readwrite(struct nvme_namespace *ns, u64 lba, char *buf, u16 count,
-                  int write)
+nvme_io_submit(struct nvme_namespace *ns, u64 lba, u16 count, u32 prp1,
+               u32 prp2, int write)
 {
-    u32 buf_addr = (u32)buf;
-
-    if ((buf_addr & 0x3) ||
-        ((buf_addr & ~(NVME_PAGE_SIZE - 1)) !=
-         ((buf_addr + ns->block_size * count - 1) & ~(NVME_PAGE_SIZE - 1)))) {
-        /* Buffer is misaligned or crosses page boundary */
-        warn_internalerror();
-        return DISK_RET_EBADTRACK;
-    }
-
     struct nvme_sqe *io_read = nvme_get_next_sqe(&ns->ctrl->io_sq,
                                                  write ? NVME_SQE_OPC_IO_WRITE
                                                        : NVME_SQE_OPC_IO_READ,
-                                                 NULL, buf);
+                                                 NULL, NULL);
+    io_read->dptr_prp1 = prp1;
+    io_read->dptr_prp2 = prp2;
     io_read->nsid = ns->ns_id;
     io_read->dword[10] = (u32)lba;
     io_read->dword[11] = (u32)(lba >> 32);
@@ -440,6 +440,55 @@ nvme_io_readwrite(struct nvme_namespace *ns, u64 lba, char *buf, u16 count,
     return DISK_RET_SUCCESS;
 }
 
+/* Reads count sectors into buf. Returns DISK_RET_*. The buffer cannot cross
+   page boundaries. */
+static int
+nvme_io_readwrite(struct nvme_namespace *ns, u64 lba, char *buf, u16 count,
+                  int write)
+{
+    u32 buf_addr = (u32)buf;
+
+    if ((buf_addr & 0x3) ||
+        ((buf_addr & ~(NVME_PAGE_SIZE - 1)) !=
+         ((buf_addr + ns->block_size * count - 1) & ~(NVME_PAGE_SIZE - 1)))) {
+        /* Buffer is misaligned or crosses page boundary */
+        warn_internalerror();
+        return DISK_RET_EBADTRACK;
+    }
+
+    return nvme_io_submit(ns, lba, count, buf_addr, 0, write);
+}
+
+/* Fills the PRP list of ns with the pages of the request buffers. Returns the
+   number of pages, or -1 if the buffers can't be described by PRP entries:
+   only the first buffer may start and only the last may end within a page. */
+static int
+nvme_build_prp(struct nvme_namespace *ns, struct disk_op_s *op)
+{
+    int iovcnt = disk_op_iovcnt(op);
+    int i, nprp = 0;
+
+    if (!ns->prp_list)
+        return -1;
+    for (i = 0; i < iovcnt; i++) {
+        struct disk_iovec_s iov = disk_op_iov(op, i);
+        u32 base = (u32)iov.buf_fl;
+        u32 end = base + iov.count * ns->block_size;
+
+        if ((base & 0x3) || (i > 0 && (base & (NVME_PAGE_SIZE - 1)))
+            || (i < iovcnt - 1 && (end & (NVME_PAGE_SIZE - 1))))
+            return -1;
+        u32 addr;
+        for (addr = base; addr < end;
+             addr = (addr & ~(NVME_PAGE_SIZE - 1)) + NVME_PAGE_SIZE) {
+            if (nprp >= ns->ctrl->max_prp)
+                return -1;
+            ns->prp_list[nprp++] = addr;
+        }
+    }
+    return nprp;
+}
+
 static int
 nvme_create_io_queues(struct nvme_ctrl *ctrl)
 {
@@ -549,6 +598,9 @@ nvme_controller_enable(struct nvme_ctrl *ctrl)
             identify->nn, (identify->nn == 1) ? "" : "s");
 
     ctrl->ns_count = identify->nn;
+    ctrl->max_prp = NVME_PRP_MAX;
+    if (identify->mdts && identify->mdts < 9)
+        ctrl->max_prp = 1U << identify->mdts;
     free(identify);
 
     if ((ctrl->ns_count == 0) || nvme_create_io_queues(ctrl)) {
@@ -651,6 +703,23 @@ nvme_cmd_readwrite(struct nvme_namespace *ns, struct disk_op_s *op, int write)
     u16 const max_blocks = NVME_PAGE_SIZE / ns->block_size;
     u16 i;
 
+    /* Transfer directly from/to the caller's buffers if possible. */
+    int nprp = nvme_build_prp(ns, op);
+    if (nprp > 0) {
+        u32 prp2 = 0;
+        if (nprp == 2)
+            prp2 = ns->prp_list[1];
+        else if (nprp > 2)
+            prp2 = (u32)&ns->prp_list[1];
+        res = nvme_io_submit(ns, op->lba, op->count, ns->prp_list[0], prp2,
+                             write);
+        dprintf(3, "ns %u %s lba %llu+%u (%d pages): %d\n", ns->ns_id,
+                write ? "write" : "read", op->lba, op->count, nprp, res);
+        return res;
+    }
+    if (disk_op_vectored(op))
+        return process_op_split(op);
+
     for (i = 0; i < op->count && res == DISK_RET_SUCCESS;) {
         u16 blocks_remaining = op->count - i;
         u16 blocks = blocks_remaining < max_blocks ? blocks_remaining
@@ -688,7 +757,10 @@ nvme_process_op(struct disk_op_s *op)
     switch (op->command) {
     case CMD_READ:
     case CMD_WRITE:
-        return nvme_cmd_readwrite(ns, op, op->command == CMD_WRITE);
+    case CMD_READV:
+    case CMD_WRITEV:
+        return nvme_cmd_readwrite(ns, op, op->command == CMD_WRITE
+                                  || op->command == CMD_WRITEV);
     default:
         return default_process_op(op);
     }
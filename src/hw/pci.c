@@ -15,44 +15,67 @@
 #if CONFIG_X86
 #define PORT_PCI_CMD           0x0cf8
 #define PORT_PCI_DATA          0x0cfc
+#define pci_config_lock()      do { } while (0)
+#define pci_config_unlock()    do { } while (0)
 #elif CONFIG_PARISC
 #include "parisc/hppa_hardware.h"
+// Dino's config address register also latches the PCI I/O port address
+#define pci_config_lock()      spin_lock(&pci_io_lock)
+#define pci_config_unlock()    spin_unlock(&pci_io_lock)
 #endif
 
 void pci_config_writel(u16 bdf, u32 addr, u32 val)
 {
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
     outl(cpu_to_le32(val), PORT_PCI_DATA);
+    pci_config_unlock();
 }
 
 void pci_config_writew(u16 bdf, u32 addr, u16 val)
 {
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
     outw(cpu_to_le16(val), PORT_PCI_DATA + (addr & 2));
+    pci_config_unlock();
 }
 
 void pci_config_writeb(u16 bdf, u32 addr, u8 val)
 {
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
     outb(val, PORT_PCI_DATA + (addr & 3));
+    pci_config_unlock();
 }
 
 u32 pci_config_readl(u16 bdf, u32 addr)
 {
+    u32 val;
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
-    return le32_to_cpu(inl(PORT_PCI_DATA));
+    val = le32_to_cpu(inl(PORT_PCI_DATA));
+    pci_config_unlock();
+    return val;
 }
 
 u16 pci_config_readw(u16 bdf, u32 addr)
 {
+    u16 val;
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
-    return le16_to_cpu(inw(PORT_PCI_DATA + (addr & 2)));
+    val = le16_to_cpu(inw(PORT_PCI_DATA + (addr & 2)));
+    pci_config_unlock();
+    return val;
 }
 
 u8 pci_config_readb(u16 bdf, u32 addr)
 {
+    u8 val;
+    pci_config_lock();
     outl(0x80000000 | (bdf << 8) | (addr & 0xfc), PORT_PCI_CMD);
-    return inb(PORT_PCI_DATA + (addr & 3));
+    val = inb(PORT_PCI_DATA + (addr & 3));
+    pci_config_unlock();
+    return val;
 }
 
 void
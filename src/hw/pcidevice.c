@@ -12,6 +12,7 @@
 #include "romfile.h" // romfile_loadint
 #include "stacks.h" // wait_preempt
 #include "string.h" // memset
+#include "x86.h" // F_EXTEND
 
 struct hlist_head PCIDevices VARVERIFY32INIT;
 int MaxPCIBus VARFSEG;
@@ -190,5 +191,10 @@ pci_enable_membar(struct pci_device *pci, u32 addr)
     }
     pci_config_maskw(pci->bdf, PCI_COMMAND, 0, PCI_COMMAND_MEMORY);
     pci->have_driver = 1;
+#if CONFIG_PARISC
+    // PCI memory lives in the I/O space, sign-extended in wide mode
+    return (void*)F_EXTEND(bar);
+#else
     return (void*)bar;
+#endif
 }
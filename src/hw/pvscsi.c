@@ -122,10 +122,20 @@ struct PVSCSIRingReqDesc {
     u8     unused[59];
 } PACKED;
 
+struct PVSCSISGElement {
+    u64    addr;
+    u32    length;
+    u32    flags;
+} PACKED;
+
+_Static_assert(PVSCSI_MAX_SG_ELEM * sizeof(struct PVSCSISGElement) == PAGE_SIZE
+               , "SG list must fill one page");
+
 struct pvscsi_ring_dsc_s {
     struct PVSCSIRingsState *ring_state;
     struct PVSCSIRingReqDesc *ring_reqs;
     struct PVSCSIRingCmpDesc *ring_cmps;
+    struct PVSCSISGElement *sg_list;
 };
 
 struct pvscsi_lun_s {
@@ -179,7 +189,10 @@ pvscsi_init_rings(void *iobase, struct pvscsi_ring_dsc_s **ring_dsc)
         (struct PVSCSIRingReqDesc *)memalign_high(PAGE_SIZE, PAGE_SIZE);
     dsc->ring_cmps =
         (struct PVSCSIRingCmpDesc *)memalign_high(PAGE_SIZE, PAGE_SIZE);
-    if (!dsc->ring_state || !dsc->ring_reqs || !dsc->ring_cmps) {
+    dsc->sg_list =
+        (struct PVSCSISGElement *)memalign_high(PAGE_SIZE, PAGE_SIZE);
+    if (!dsc->ring_state || !dsc->ring_reqs || !dsc->ring_cmps
+        || !dsc->sg_list) {
         warn_noalloc();
         return;
     }
@@ -228,6 +241,10 @@ pvscsi_process_op(struct disk_op_s *op)
         return DISK_RET_EBADTRACK;
     }
 
+    int iovcnt = disk_op_iovcnt(op);
+    if (iovcnt > PVSCSI_MAX_SG_ELEM)
+        return process_op_split(op);
+
     req = ring_dsc->ring_reqs + (s->reqProdIdx & MASK(req_entries));
     int blocksize = scsi_fill_cmd(op, req->cdb, 16);
     if (blocksize < 0)
@@ -244,7 +261,19 @@ pvscsi_process_op(struct disk_op_s *op)
     req->flags = scsi_is_read(op) ?
         PVSCSI_FLAG_CMD_DIR_TOHOST : PVSCSI_FLAG_CMD_DIR_TODEVICE;
     req->dataLen = op->count * blocksize;
-    req->dataAddr = (u32)op->buf_fl;
+    if (disk_op_vectored(op)) {
+        int i;
+        for (i = 0; i < iovcnt; i++) {
+            struct disk_iovec_s iov = disk_op_iov(op, i);
+            ring_dsc->sg_list[i].addr = (u32)iov.buf_fl;
+            ring_dsc->sg_list[i].length = iov.count * blocksize;
+            ring_dsc->sg_list[i].flags = 0;
+        }
+        req->flags |= PVSCSI_FLAG_CMD_WITH_SG_LIST;
+        req->dataAddr = virt_to_phys(ring_dsc->sg_list);
+    } else {
+        req->dataAddr = (u32)op->buf_fl;
+    }
     s->reqProdIdx = s->reqProdIdx + 1;
 
     pvscsi_kick_rw_io(plun->iobase);
@@ -1,6 +1,8 @@
 #ifndef _PVSCSI_H_
 #define _PVSCSI_H_
 
+#define PVSCSI_MAX_SG_ELEM 256  // 16 byte SG elements in one 4k page
+
 struct disk_op_s;
 int pvscsi_process_op(struct disk_op_s *op);
 void pvscsi_setup(void);
@@ -12,6 +12,7 @@
 #include "pcidevice.h" // foreachpci
 #include "pci_ids.h" // PCI_CLASS_SERIAL_USB_UHCI
 #include "pci_regs.h" // PCI_BASE_ADDRESS_0
+#include "pollwait.h" // pollwait_step
 #include "string.h" // memset
 #include "usb.h" // struct usb_s
 #include "usb-ehci.h" // struct ehci_qh
@@ -35,6 +36,8 @@ struct ehci_pipe {
 
 static int PendingEHCI;
 
+DECLARE_POLLWAIT_STATS(ehci_pollwait, "ehci");
+
 
 /****************************************************************
  * Root hub
@@ -506,11 +509,14 @@ static int
 ehci_wait_td(struct ehci_pipe *pipe, struct ehci_qtd *td, u32 end)
 {
     u32 status;
+    struct pollwait_s pw;
+    pollwait_init(&pw, &ehci_pollwait);
     for (;;) {
         status = td->token;
         if (!(status & QTD_STS_ACTIVE))
             break;
         if (timer_check(end)) {
+            pollwait_timeout(&pw);
             u32 cur = GET_LOWFLAT(pipe->qh.current);
             u32 tok = GET_LOWFLAT(pipe->qh.token);
             u32 next = GET_LOWFLAT(pipe->qh.qtd_next);
@@ -523,8 +529,9 @@ ehci_wait_td(struct ehci_pipe *pipe, struct ehci_qtd *td, u32 end)
             ehci_waittick(cntl);
             return -1;
         }
-        yield();
+        pollwait_step(&pw);
     }
+    pollwait_done(&pw);
     if (status & QTD_STS_HALT) {
         dprintf(1, "ehci_wait_td error - status=%x\n", status);
         ehci_reset_pipe(pipe);
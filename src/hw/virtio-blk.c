@@ -15,6 +15,7 @@
 #include "pcidevice.h" // foreachpci
 #include "pci_ids.h" // PCI_DEVICE_ID_VIRTIO_BLK
 #include "pci_regs.h" // PCI_VENDOR_ID
+#include "pollwait.h" // pollwait_step
 #include "stacks.h" // run_thread
 #include "std/disk.h" // DISK_RET_SUCCESS
 #include "string.h" // memset
@@ -29,43 +30,49 @@ struct virtiodrive_s {
     struct vp_device vp;
 };
 
+DECLARE_POLLWAIT_STATS(virtio_blk_pollwait, "virtio-blk");
+
 static int
 virtio_blk_op(struct disk_op_s *op, int write)
 {
     struct virtiodrive_s *vdrive =
         container_of(op->drive_fl, struct virtiodrive_s, drive);
     struct vring_virtqueue *vq = vdrive->vq;
+    int iovcnt = disk_op_iovcnt(op);
+    if (iovcnt > VIRTIO_BLK_IOV_MAX || iovcnt + 2 > vq->vring.num)
+        return process_op_split(op);
     struct virtio_blk_outhdr hdr = {
         .type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
         .ioprio = 0,
         .sector = op->lba,
     };
     u8 status = VIRTIO_BLK_S_UNSUPP;
-    struct vring_list sg[] = {
-        {
-            .addr       = (void*)(&hdr),
-            .length     = sizeof(hdr),
-        },
-        {
-            .addr       = op->buf_fl,
-            .length     = vdrive->drive.blksize * op->count,
-        },
-        {
-            .addr       = (void*)(&status),
-            .length     = sizeof(status),
-        },
-    };
+    struct vring_list sg[VIRTIO_BLK_IOV_MAX + 2];
+    int i;
+
+    sg[0].addr   = (void*)(&hdr);
+    sg[0].length = sizeof(hdr);
+    for (i = 0; i < iovcnt; i++) {
+        struct disk_iovec_s iov = disk_op_iov(op, i);
+        sg[i + 1].addr   = iov.buf_fl;
+        sg[i + 1].length = vdrive->drive.blksize * iov.count;
+    }
+    sg[iovcnt + 1].addr   = (void*)(&status);
+    sg[iovcnt + 1].length = sizeof(status);
 
     /* Add to virtqueue and kick host */
     if (write)
-        vring_add_buf(vq, sg, 2, 1, 0, 0);
+        vring_add_buf(vq, sg, iovcnt + 1, 1, 0, 0);
     else
-        vring_add_buf(vq, sg, 1, 2, 0, 0);
+        vring_add_buf(vq, sg, 1, iovcnt + 1, 0, 0);
     vring_kick(&vdrive->vp, vq, 1);
 
     /* Wait for reply */
+    struct pollwait_s pw;
+    pollwait_init(&pw, &virtio_blk_pollwait);
     while (!vring_more_used(vq))
-        usleep(5);
+        pollwait_step(&pw);
+    pollwait_done(&pw);
 
     /* Reclaim virtqueue element */
     vring_get_buf(vq, NULL);
@@ -85,8 +92,10 @@ virtio_blk_process_op(struct disk_op_s *op)
         return 0;
     switch (op->command) {
     case CMD_READ:
+    case CMD_READV:
         return virtio_blk_op(op, 0);
     case CMD_WRITE:
+    case CMD_WRITEV:
         return virtio_blk_op(op, 1);
     default:
         return default_process_op(op);
@@ -36,6 +36,9 @@ struct virtio_blk_outhdr {
 #define VIRTIO_BLK_S_IOERR      1
 #define VIRTIO_BLK_S_UNSUPP     2
 
+// Largest number of buffer segments passed in one request
+#define VIRTIO_BLK_IOV_MAX 16
+
 struct disk_op_s;
 int virtio_blk_process_op(struct disk_op_s *op);
 void virtio_blk_setup(void);
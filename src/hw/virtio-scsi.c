@@ -43,8 +43,11 @@ virtio_scsi_process_op(struct disk_op_s *op)
     struct vring_virtqueue *vq = vlun->vq;
     struct virtio_scsi_req_cmd req;
     struct virtio_scsi_resp_cmd resp;
-    struct vring_list sg[3];
+    struct vring_list sg[VIRTIO_SCSI_IOV_MAX + 2];
 
+    int iovcnt = disk_op_iovcnt(op);
+    if (iovcnt > VIRTIO_SCSI_IOV_MAX || iovcnt + 2 > vq->vring.num)
+        return process_op_split(op);
     memset(&req, 0, sizeof(req));
     int blocksize = scsi_fill_cmd(op, req.cdb, 16);
     if (blocksize < 0)
@@ -56,8 +59,9 @@ virtio_scsi_process_op(struct disk_op_s *op)
 
     u32 len = op->count * blocksize;
     int datain = scsi_is_read(op);
-    int in_num = (datain ? 2 : 1);
-    int out_num = (len ? 3 : 2) - in_num;
+    int data_num = (len ? iovcnt : 0);
+    int in_num = 1 + (datain ? data_num : 0);
+    int out_num = 1 + (datain ? 0 : data_num);
 
     sg[0].addr   = (void*)(&req);
     sg[0].length = sizeof(req);
@@ -65,10 +69,11 @@ virtio_scsi_process_op(struct disk_op_s *op)
     sg[out_num].addr   = (void*)(&resp);
     sg[out_num].length = sizeof(resp);
 
-    if (len) {
-        int data_idx = (datain ? 2 : 1);
-        sg[data_idx].addr   = op->buf_fl;
-        sg[data_idx].length = len;
+    int i, data_idx = (datain ? 2 : 1);
+    for (i = 0; i < data_num; i++) {
+        struct disk_iovec_s iov = disk_op_iov(op, i);
+        sg[data_idx + i].addr   = iov.buf_fl;
+        sg[data_idx + i].length = iov.count * blocksize;
     }
 
     /* Add to virtqueue and kick host */
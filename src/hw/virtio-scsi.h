@@ -40,6 +40,9 @@ struct virtio_scsi_resp_cmd {
 
 #define VIRTIO_SCSI_S_OK            0
 
+// Largest number of buffer segments passed in one request
+#define VIRTIO_SCSI_IOV_MAX 16
+
 struct disk_op_s;
 int virtio_scsi_process_op(struct disk_op_s *op);
 void virtio_scsi_setup(void);
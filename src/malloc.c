@@ -270,7 +270,7 @@ x86_malloc(struct zone_s *zone, u32 size, u32 align)
 
 // Free a data block allocated with phys_alloc
 int
-malloc_pfree(u32 data)
+malloc_pfree(unsigned long data)
 {
     ASSERT32FLAT();
     struct allocinfo_s *info = alloc_find(data);
@@ -278,7 +278,7 @@ malloc_pfree(u32 data)
         return -1;
     struct allocdetail_s *detail = container_of(
         info, struct allocdetail_s, datainfo);
-    dprintf(8, "phys_free %x (detail=%p)\n", data, detail);
+    dprintf(8, "phys_free %lx (detail=%p)\n", data, detail);
     alloc_free(info);
     alloc_free(&detail->detailinfo);
     return 0;
@@ -17,11 +17,12 @@ extern u32 LegacyRamSize;
 void malloc_init(void);
 void malloc_prepboot(void);
 unsigned long malloc_palloc(struct zone_s *zone, u32 size, u32 align);
-void *parisc_malloc(u32 size, u32 align);
+void *parisc_malloc(struct zone_s *zone, u32 size, u32 align);
+void malloc_show_stats(void);
 void *x86_malloc(struct zone_s *zone, u32 size, u32 align);
 #define _malloc(zone, size, align) \
-    (CONFIG_X86 ? x86_malloc(zone, size, align) : parisc_malloc(size, align))
-int malloc_pfree(u32 data);
+    (CONFIG_X86 ? x86_malloc(zone, size, align) : parisc_malloc(zone, size, align))
+int malloc_pfree(unsigned long data);
 void free(void *data);
 u32 malloc_getspace(struct zone_s *zone);
 void malloc_sethandle(u32 data, u32 handle);
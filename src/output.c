@@ -35,6 +35,12 @@ debug_banner(void)
     dprintf(1, "BUILD: %s\n", BUILDINFO);
 }
 
+#if CONFIG_PARISC
+// The serial console is shared by all CPUs.  serial_lock protects the
+// UART registers and the receive ring.
+static spinlock_t serial_lock = SPIN_LOCK_UNLOCKED;
+#endif
+
 // Write a character to debug port(s).
 static void
 debug_putc(struct putcinfo *action, char c)
@@ -42,7 +48,13 @@ debug_putc(struct putcinfo *action, char c)
     if (! CONFIG_DEBUG_LEVEL)
         return;
 #if 1
+#if CONFIG_PARISC
+    spin_lock(&serial_lock);
+    qemu_debug_putc(c);
+    spin_unlock(&serial_lock);
+#else
     qemu_debug_putc(c);
+#endif
     if (!MODESEGMENT)
         coreboot_debug_putc(c);
 #else
@@ -73,20 +85,68 @@ static struct putcinfo debuginfo = { debug_putc };
  * Screen writing
  ****************************************************************/
 
+#if CONFIG_PARISC
+#define UART_RX_RING_SIZE 256   // power of 2
+
+// Characters received on the serial console, not yet read by ENTRY_IO_CIN.
+static struct {
+    u8 buf[UART_RX_RING_SIZE];
+    u32 head, tail;
+} rx_ring;
+
+// Move received characters from the UART into the receive ring.  The
+// caller holds serial_lock.
+static u8
+parisc_serial_drain(u8 lsr)
+{
+    const portaddr_t addr = PORT_SERIAL1;
+    while (lsr & 0x01) {
+        u8 c = inb(addr+SEROFF_DATA);
+        if (rx_ring.head - rx_ring.tail < UART_RX_RING_SIZE)
+            rx_ring.buf[rx_ring.head++ % UART_RX_RING_SIZE] = c;
+        lsr = inb(addr+SEROFF_LSR);
+    }
+    return lsr;
+}
+
+void
+parisc_serial_poll(void)
+{
+    spin_lock(&serial_lock);
+    parisc_serial_drain(inb(PORT_SERIAL1+SEROFF_LSR));
+    spin_unlock(&serial_lock);
+}
+
+// Copy up to 'max' received characters to 'c' without waiting.
+int
+parisc_serial_read(char *c, int max)
+{
+    int count = 0;
+    spin_lock(&serial_lock);
+    parisc_serial_drain(inb(PORT_SERIAL1+SEROFF_LSR));
+    while (count < max && rx_ring.tail != rx_ring.head)
+        c[count++] = rx_ring.buf[rx_ring.tail++ % UART_RX_RING_SIZE];
+    spin_unlock(&serial_lock);
+    return count;
+}
+#endif
+
 // Show a character on the screen.
 static void
 screenc(char c)
 {
 #if CONFIG_PARISC
+    spin_lock(&serial_lock);
     for (;;) {
 	const portaddr_t addr = PORT_SERIAL1;
-        u8 lsr = inb(addr+SEROFF_LSR);
+        u8 lsr = parisc_serial_drain(inb(addr+SEROFF_LSR));
         if ((lsr & 0x60) == 0x60) {
             // Success - can write data
             outb(c, addr+SEROFF_DATA);
             break;
         }
     }
+    spin_unlock(&serial_lock);
 #endif
     if (!MODESEGMENT && GET_IVT(0x10).segoff == FUNC16(entry_10).segoff)
         // No need to thunk to 16bit mode if vgabios is not present
@@ -105,6 +165,55 @@ screenc(char c)
 #endif
 }
 
+#if CONFIG_PARISC
+#define UART_FIFO_SIZE 16
+
+// Write a buffer to the serial console.  Check LSR only once per burst
+// and fill the transmit FIFO up to its depth if it is enabled.
+static void
+parisc_serial_write(const char *s, int len)
+{
+    const portaddr_t addr = PORT_SERIAL1;
+    int burst = 1, cr = 0;
+
+    spin_lock(&serial_lock);
+    if ((inb(addr+SEROFF_IIR) & 0xc0) == 0xc0)
+        burst = UART_FIFO_SIZE;
+    while (len) {
+        if (!(parisc_serial_drain(inb(addr+SEROFF_LSR)) & 0x20))
+            continue;
+        int n;
+        for (n = 0; n < burst && len; n++) {
+            if (*s == '\n' && !cr) {
+                outb('\r', addr+SEROFF_DATA);
+                cr = 1;
+                continue;
+            }
+            outb(*s++, addr+SEROFF_DATA);
+            len--;
+            cr = 0;
+        }
+    }
+    spin_unlock(&serial_lock);
+}
+
+// Write a buffer to the console without going through printf.
+void
+parisc_screen_write(const char *s, int len)
+{
+    int i;
+
+    if (ScreenAndDebug)
+        for (i = 0; i < len; i++)
+            debug_putc(&debuginfo, s[i]);
+    parisc_serial_write(s, len);
+    if (GET_IVT(0x10).segoff == FUNC16(entry_10).segoff)
+        return;
+    extern void parisc_teletype_write(const char *s, int len);
+    parisc_teletype_write(s, len);
+}
+#endif
+
 // Handle a character from a printf request.
 static void
 screen_putc(struct putcinfo *action, char c)
@@ -296,18 +405,21 @@ bvprintf(struct putcinfo *action, const char *fmt, va_list args)
 		val64 = va_arg(args, s32);
             putuint(action, val64);
             break;
-        case 'p':
-            val = va_arg(args, s32);
+        case 'p': {
+            unsigned long ptr = va_arg(args, unsigned long);
             if (!MODESEGMENT && GET_GLOBAL(*(u8*)(n+1)) == 'P') {
                 // %pP is 'struct pci_device' printer
-                put_pci_device(action, (void*)val);
+                put_pci_device(action, (void*)ptr);
                 n++;
                 break;
             }
             putc(action, '0');
             putc(action, 'x');
-            puthex(action, val, 8);
+            if (sizeof(ptr) > sizeof(u32))
+                puthex(action, (u64)ptr >> 32, 8);
+            puthex(action, ptr, 8);
             break;
+        }
         case 'x':
 	    if (is64)
 		val64 = va_arg(args, s64);
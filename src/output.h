@@ -31,6 +31,9 @@ void __set_code_invalid(struct bregs *regs, u32 linecode, const char *fname);
 void __set_code_unimplemented(struct bregs *regs, u32 linecode
                               , const char *fname);
 void hexdump(const void *d, int len);
+void parisc_serial_poll(void);
+int parisc_serial_read(char *c, int max);
+void parisc_screen_write(const char *s, int len);
 
 #define dprintf(lvl, fmt, args...) do {                         \
         if (CONFIG_DEBUG_LEVEL && (lvl) <= CONFIG_DEBUG_LEVEL)  \
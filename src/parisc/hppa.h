@@ -139,6 +139,48 @@ static inline unsigned long rdtscll(void)
     return mfctl(16);
 }
 
+#define __mfctl(reg)	mfctl(reg)
+
+/* HPA of the executing CPU, stored in CPU_HPA_CR_REG by head.S */
+static inline unsigned long cpu_hpa(void)
+{
+    return __mfctl(CPU_HPA_CR_REG);
+}
+
+/* Index of the executing CPU */
+static inline unsigned int cpu_index(void)
+{
+    unsigned int index = (cpu_hpa() - CPU_HPA) / 0x1000;
+    return (index < HPPA_MAX_CPUS) ? index : HPPA_MAX_CPUS - 1;
+}
+
+/* ldcw atomically loads and clears a 16 byte aligned word: 1 is unlocked */
+typedef struct {
+    volatile unsigned int lock;
+} __attribute__((aligned(16))) spinlock_t;
+
+#define SPIN_LOCK_UNLOCKED { 1 }
+
+static inline unsigned int __ldcw(volatile unsigned int *a)
+{
+    unsigned int ret;
+    asm volatile("ldcw 0(%1),%0" : "=r" (ret) : "r" (a) : "memory");
+    return ret;
+}
+
+static inline void spin_lock(spinlock_t *l)
+{
+    while (__ldcw(&l->lock) == 0)
+        while (l->lock == 0)
+            ;
+}
+
+static inline void spin_unlock(spinlock_t *l)
+{
+    asm volatile("" : : : "memory");
+    l->lock = 1;
+}
+
 static inline u32 __ffs(u32 x)
 {
 	unsigned long ret;
@@ -147,7 +189,7 @@ static inline u32 __ffs(u32 x)
 		return 0;
 
 	__asm__(
-#ifdef CONFIG_64BIT
+#if CONFIG_64BIT
 		" ldi       63,%1\n"
 		" extrd,u,*<>  %0,63,32,%%r0\n"
 		" extrd,u,*TR  %0,31,32,%0\n"	/* move top 32-bits down */
@@ -208,113 +250,185 @@ static inline u32 rol(u32 val, u16 rol) {
     return res;
 }
 
+/* 32-bit I/O addresses have to be sign-extended in wide mode */
+#if CONFIG_64BIT
+#define F_EXTEND(x) ((unsigned long)((x) | (0xffffffff00000000ULL)))
+#else
+#define F_EXTEND(x) ((unsigned long)(x))
+#endif
+
 #define pci_ioport_addr(port) ((port >= 0x1000)  && (port < FIRMWARE_START))
 
+/* Dino's PCI_CONFIG_ADDR holds the address for PCI_IO_DATA and for config
+ * space accesses.  Firmware calls run on several CPUs at once, so hold
+ * pci_io_lock from writing the address until the data has been moved. */
+extern spinlock_t pci_io_lock;
+
 static inline void outl(u32 value, portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-        *(volatile u32 *)(port) = be32_to_cpu(value);
+        *(volatile u32 *)F_EXTEND(port) = be32_to_cpu(value);
     } else {
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port, DINO_HPA + 0x064);
 	/* write value to PCI_IO_DATA */
 	outl(value, DINO_HPA + 0x06c);
+	spin_unlock(&pci_io_lock);
     }
 }
 
 static inline void outw(u16 value, portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-        *(volatile u16 *)(port) = be16_to_cpu(value);
+        *(volatile u16 *)F_EXTEND(port) = be16_to_cpu(value);
     } else {
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port, DINO_HPA + 0x064);
 	/* write value to PCI_IO_DATA */
 	outw(value, DINO_HPA + 0x06c);
+	spin_unlock(&pci_io_lock);
     }
 }
 
 static inline void outb(u8 value, portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-	*(volatile u8 *)(port) = value;
+	*(volatile u8 *)F_EXTEND(port) = value;
     } else {
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port & ~3U, DINO_HPA + 0x064);
 	/* write value to PCI_IO_DATA */
 	outb(value, DINO_HPA + 0x06c + (port & 3));
+	spin_unlock(&pci_io_lock);
     }
 }
 
 static inline u8 inb(portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-        return *(volatile u8 *)(port);
+        return *(volatile u8 *)F_EXTEND(port);
     } else {
+	u8 value;
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port & ~3U, DINO_HPA + 0x064);
 	/* read value to PCI_IO_DATA */
-	return inb(DINO_HPA + 0x06c + (port & 3));
+	value = inb(DINO_HPA + 0x06c + (port & 3));
+	spin_unlock(&pci_io_lock);
+	return value;
     }
 }
 
 static inline u16 inw(portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-        return *(volatile u16 *)(port);
+        return *(volatile u16 *)F_EXTEND(port);
     } else {
+	u16 value;
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port & ~3U, DINO_HPA + 0x064);
 	/* read value to PCI_IO_DATA */
-	return inw(DINO_HPA + 0x06c + (port & 3));
+	value = inw(DINO_HPA + 0x06c + (port & 3));
+	spin_unlock(&pci_io_lock);
+	return value;
     }
 }
 static inline u32 inl(portaddr_t port) {
     if (!pci_ioport_addr(port)) {
-        return *(volatile u32 *)(port);
+        return *(volatile u32 *)F_EXTEND(port);
     } else {
+	u32 value;
+	spin_lock(&pci_io_lock);
 	/* write PCI I/O address to Dino's PCI_CONFIG_ADDR */
 	outl(port & ~3U, DINO_HPA + 0x064);
 	/* read value to PCI_IO_DATA */
-	return inl(DINO_HPA + 0x06c + (port & 3));
+	value = inl(DINO_HPA + 0x06c + (port & 3));
+	spin_unlock(&pci_io_lock);
+	return value;
     }
 }
 
+/*
+ * String I/O to PCI ports: Dino keeps the address written to PCI_CONFIG_ADDR
+ * latched, so write it once per block and then stream PCI_IO_DATA.  The
+ * caller holds pci_io_lock for the whole block.
+ */
+static inline volatile void *pci_io_latch(portaddr_t port) {
+	outl(port & ~3U, DINO_HPA + DINO_PCI_ADDR);
+	return (volatile void *)F_EXTEND(DINO_HPA + DINO_IO_DATA + (port & 3));
+}
+
 static inline void insb(portaddr_t port, u8 *data, u32 count) {
+    if (!pci_ioport_addr(port)) {
+	while (count--)
+		*data++ = inb(port);
+	return;
+    }
+    spin_lock(&pci_io_lock);
+    volatile u8 *io = pci_io_latch(port);
     while (count--)
-	*data++ = inb(port);
+	*data++ = *io;
+    spin_unlock(&pci_io_lock);
 }
 static inline void insw(portaddr_t port, u16 *data, u32 count) {
-    while (count--)
-	if (pci_ioport_addr(port))
-		*data++ = be16_to_cpu(inw(port));
-	else
+    if (!pci_ioport_addr(port)) {
+	while (count--)
 		*data++ = inw(port);
+	return;
+    }
+    spin_lock(&pci_io_lock);
+    volatile u16 *io = pci_io_latch(port);
+    while (count--)
+	*data++ = be16_to_cpu(*io);
+    spin_unlock(&pci_io_lock);
 }
 static inline void insl(portaddr_t port, u32 *data, u32 count) {
-    while (count--)
-	if (pci_ioport_addr(port))
-		*data++ = be32_to_cpu(inl(port));
-	else
+    if (!pci_ioport_addr(port)) {
+	while (count--)
 		*data++ = inl(port);
+	return;
+    }
+    spin_lock(&pci_io_lock);
+    volatile u32 *io = pci_io_latch(port);
+    while (count--)
+	*data++ = be32_to_cpu(*io);
+    spin_unlock(&pci_io_lock);
 }
 // XXX - outs not limited to es segment
 static inline void outsb(portaddr_t port, u8 *data, u32 count) {
+    if (!pci_ioport_addr(port)) {
+	while (count--)
+		outb(*data++, port);
+	return;
+    }
+    spin_lock(&pci_io_lock);
+    volatile u8 *io = pci_io_latch(port);
     while (count--)
-	outb(*data++, port);
+	*io = *data++;
+    spin_unlock(&pci_io_lock);
 }
 static inline void outsw(portaddr_t port, u16 *data, u32 count) {
-    while (count--) {
-	if (pci_ioport_addr(port))
-		outw(cpu_to_be16(*data), port);
-	else
-		outw(*data, port);
-	data++;
+    if (!pci_ioport_addr(port)) {
+	while (count--)
+		outw(*data++, port);
+	return;
     }
+    spin_lock(&pci_io_lock);
+    volatile u16 *io = pci_io_latch(port);
+    while (count--)
+	*io = cpu_to_be16(*data++);
+    spin_unlock(&pci_io_lock);
 }
 static inline void outsl(portaddr_t port, u32 *data, u32 count) {
-    while (count--) {
-	if (pci_ioport_addr(port))
-		outl(cpu_to_be32(*data), port);
-	else
-		outl(*data, port);
-	data++;
+    if (!pci_ioport_addr(port)) {
+	while (count--)
+		outl(*data++, port);
+	return;
     }
+    spin_lock(&pci_io_lock);
+    volatile u32 *io = pci_io_latch(port);
+    while (count--)
+	*io = cpu_to_be32(*data++);
+    spin_unlock(&pci_io_lock);
 }
 
 /* Compiler barrier is enough as an x86 CPU does not reorder reads or writes */
@@ -2,9 +2,17 @@
 
 #define FIRMWARE_START	0xf0000000
 #define FIRMWARE_END	0xf0800000
+#define FIRMWARE_HIGH	0xfffffff0	/* upper half of the firmware address in wide mode */
+
+#define RAM_HIGH_START	0x100000000ULL	/* RAM above FIRMWARE_START (64-bit) */
+
+#define CPU_HPA_CR_REG	7	/* HPA of each CPU, SeaBIOS internal */
+#define PDC_STACK_SHIFT	14	/* 16 KB PDC stack per CPU, SeaBIOS internal */
 
 #define DEVICE_HPA_LEN	0x00100000
 
+#define QEMU_FW_CFG_IO_BASE	0xfffa0000
+
 /* ftp://parisc.parisc-linux.org/docs/chips/pcxl2_ers.pdf */
 #define IO_BROADCAST	0xfffc0000
 #define   FLEXID	0x0020
@@ -31,8 +39,8 @@
 #define LASI_PS2KBD_HPA	0xffd08000
 #define LASI_PS2MOU_HPA	0xffd08100
 #define LASI_GFX_HPA	0xf8000000
-#define CPU_HPA		0xfffb0000
-#define MEMORY_HPA	0xfffbf000
+#define CPU_HPA		0xfffb0000	/* + cpu * 0x1000 for each CPU */
+#define MEMORY_HPA	0xfffff000	/* above the CPUs, 0xfffbf000 on a B160L */
 
 #define PCI_HPA         DINO_HPA        /* PCI bus */
 #define IDE_HPA         0xf9000000      /* Boot disc controller */
@@ -48,7 +56,7 @@
 #define PORT_SERIAL1    (DINO_UART_HPA + 0x800)
 #define PORT_SERIAL2    (LASI_UART_HPA + 0x800)
 
-#define HPPA_MAX_CPUS   8      /* max. number of SMP CPUs */
+#define HPPA_MAX_CPUS   16     /* max. number of SMP CPUs */
 #define CPU_CLOCK_MHZ   250     /* emulate a 250 MHz CPU */
 
 
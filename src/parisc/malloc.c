@@ -14,51 +14,308 @@
 #include "stacks.h" // wait_preempt
 #include "std/optionrom.h" // OPTION_ROM_ALIGN
 #include "string.h" // memset
+#include "parisc/hppa_hardware.h" // FIRMWARE_END
+
+/*
+ * The firmware heap starts behind the bss section and ends at
+ * FIRMWARE_END.  Each zone carves chunks (arenas) from it and manages
+ * them with size-class free lists.  Every block carries a header with
+ * the size of itself and of its predecessor, so neighbouring free
+ * blocks get coalesced when a block is released.
+ */
+
+// Header in front of every block of a chunk.
+struct allocblk_s {
+    u32 size;           // size of this block, including the header
+    u32 prev_size;      // size of preceding block, 0 if first in chunk
+    struct zone_s *zone;
+    u32 magic;
+} __aligned(MALLOC_MIN_ALIGN);
+
+// Free blocks keep their free list node behind the header.
+struct freeblk_s {
+    struct allocblk_s blk;
+    struct hlist_node node;
+};
+
+#define ALLOC_MAGIC_USED        0x55534544      // "USED"
+#define ALLOC_MAGIC_FREE        0x46524545      // "FREE"
+#define ALLOC_MAGIC_END         0x454e4421      // "END!"
+
+#define ALLOC_MIN_BLOCK         ALIGN(sizeof(struct freeblk_s), MALLOC_MIN_ALIGN)
+#define ALLOC_CLASS_MIN         32
+#define ALLOC_CLASSES           12      // 32 bytes ... 64 KB and above
+#define ALLOC_CHUNK_SIZE        (64*1024)
+
+// The various memory zones.
+struct zone_s {
+    const char *name;
+    struct hlist_head free[ALLOC_CLASSES];
+    u32 arena_size;     // bytes taken from the heap
+    u32 live, peak;     // bytes handed out to callers
+    u32 allocs, frees;
+};
+
+// Permanent allocations
+struct zone_s ZoneHigh = { .name = "permanent" };
+// Temporary allocations during POST
+struct zone_s ZoneTmpHigh = { .name = "temp" };
+// Page aligned allocations (DMA rings, queues)
+static struct zone_s ZoneDma = { .name = "dma" };
+// Zones of the x86 memory layout, mapped onto the ones above.
+struct zone_s ZoneLow, ZoneFSeg, ZoneTmpLow;
+
+static struct zone_s *Zones[] = {
+    &ZoneHigh, &ZoneTmpHigh, &ZoneDma
+};
+
+extern u8 _ebss;
+static unsigned long heap_cur, heap_end;
+
+
+/****************************************************************
+ * free lists
+ ****************************************************************/
+
+static int
+size_class(u32 size)
+{
+    int cls = 0;
+    size /= ALLOC_CLASS_MIN;
+    while (size > 1 && cls < ALLOC_CLASSES-1) {
+        size >>= 1;
+        cls++;
+    }
+    return cls;
+}
+
+static inline struct allocblk_s *
+blk_next(struct allocblk_s *blk)
+{
+    return (void*)blk + blk->size;
+}
+
+static void
+freelist_add(struct allocblk_s *blk)
+{
+    struct freeblk_s *fb = container_of(blk, struct freeblk_s, blk);
+    blk->magic = ALLOC_MAGIC_FREE;
+    hlist_add_head(&fb->node, &blk->zone->free[size_class(blk->size)]);
+}
+
+static void
+freelist_del(struct allocblk_s *blk)
+{
+    struct freeblk_s *fb = container_of(blk, struct freeblk_s, blk);
+    hlist_del(&fb->node);
+}
+
+// Split 'blk' after 'size' bytes and return the new tail block.
+static struct allocblk_s *
+blk_split(struct allocblk_s *blk, u32 size)
+{
+    struct allocblk_s *tail = (void*)blk + size;
+    tail->size = blk->size - size;
+    tail->prev_size = size;
+    tail->zone = blk->zone;
+    blk->size = size;
+    blk_next(tail)->prev_size = tail->size;
+    return tail;
+}
+
+// Put a block back on the free lists, merging it with free neighbours.
+static void
+blk_release(struct allocblk_s *blk)
+{
+    struct allocblk_s *next = blk_next(blk);
+    if (next->magic == ALLOC_MAGIC_FREE) {
+        freelist_del(next);
+        blk->size += next->size;
+    }
+    if (blk->prev_size) {
+        struct allocblk_s *prev = (void*)blk - blk->prev_size;
+        if (prev->magic == ALLOC_MAGIC_FREE) {
+            freelist_del(prev);
+            prev->size += blk->size;
+            blk = prev;
+        }
+    }
+    blk_next(blk)->prev_size = blk->size;
+    freelist_add(blk);
+}
+
+
+/****************************************************************
+ * zone arenas
+ ****************************************************************/
+
+// Add a new chunk of at least 'size' bytes to a zone.
+static int
+zone_grow(struct zone_s *zone, u32 size)
+{
+    unsigned long start = ALIGN(heap_cur, PAGE_SIZE);
+    u32 chunk = ALIGN(size + 2*sizeof(struct allocblk_s), PAGE_SIZE);
+    if (chunk < ALLOC_CHUNK_SIZE)
+        chunk = ALLOC_CHUNK_SIZE;
+    if (start + chunk > heap_end || start + chunk < start)
+        chunk = ALIGN(size + 2*sizeof(struct allocblk_s), MALLOC_MIN_ALIGN);
+    if (start + chunk > heap_end || start + chunk < start)
+        return -1;
+    heap_cur = start + chunk;
+    zone->arena_size += chunk;
+
+    // One free block spanning the chunk, terminated by an end marker.
+    struct allocblk_s *blk = (void*)start;
+    struct allocblk_s *end = (void*)start + chunk - sizeof(*end);
+    blk->size = chunk - sizeof(*end);
+    blk->prev_size = 0;
+    blk->zone = zone;
+    end->size = 0;
+    end->prev_size = blk->size;
+    end->zone = zone;
+    end->magic = ALLOC_MAGIC_END;
+    freelist_add(blk);
+    dprintf(8, "zone %s: new chunk 0x%lx size=%d\n", zone->name, start, chunk);
+    return 0;
+}
+
+// Try to place 'need' bytes aligned to 'align' into free block 'blk'.
+static void *
+blk_alloc(struct allocblk_s *blk, u32 need, u32 align)
+{
+    unsigned long start = (unsigned long)blk;
+    unsigned long data = ALIGN(start + sizeof(*blk), align);
+    u32 lead = data - sizeof(*blk) - start;
+    if (lead && lead < ALLOC_MIN_BLOCK) {
+        data += ALIGN(ALLOC_MIN_BLOCK - lead, align);
+        lead = data - sizeof(*blk) - start;
+    }
+    if (lead + need > blk->size || lead + need < lead)
+        return NULL;
+
+    freelist_del(blk);
+    if (lead) {
+        struct allocblk_s *head = blk;
+        blk = blk_split(head, lead);
+        freelist_add(head);
+    }
+    if (blk->size - need >= ALLOC_MIN_BLOCK)
+        freelist_add(blk_split(blk, need));
+    blk->magic = ALLOC_MAGIC_USED;
+    return (void*)data;
+}
+
+static void *
+zone_alloc(struct zone_s *zone, u32 size, u32 align)
+{
+    u32 need = ALIGN(size, MALLOC_MIN_ALIGN) + sizeof(struct allocblk_s);
+    if (need < ALLOC_MIN_BLOCK)
+        need = ALLOC_MIN_BLOCK;
+    if (align < MALLOC_MIN_ALIGN)
+        align = MALLOC_MIN_ALIGN;
+
+    for (;;) {
+        int cls;
+        for (cls = size_class(need); cls < ALLOC_CLASSES; cls++) {
+            struct freeblk_s *fb;
+            hlist_for_each_entry(fb, &zone->free[cls], node) {
+                void *data = blk_alloc(&fb->blk, need, align);
+                if (!data)
+                    continue;
+                struct allocblk_s *blk = data - sizeof(*blk);
+                zone->allocs++;
+                zone->live += blk->size;
+                if (zone->live > zone->peak)
+                    zone->peak = zone->live;
+                return data;
+            }
+        }
+        if (zone_grow(zone, need + align))
+            return NULL;
+    }
+}
+
+// Map the generic zones onto the parisc arenas.
+static struct zone_s *
+zone_select(struct zone_s *zone, u32 align)
+{
+    if (align >= PAGE_SIZE)
+        return &ZoneDma;
+    if (zone == &ZoneTmpHigh || zone == &ZoneTmpLow)
+        return &ZoneTmpHigh;
+    return &ZoneHigh;
+}
 
-static unsigned long stackptr;
 
 /****************************************************************
  * tracked memory allocations
  ****************************************************************/
 
-// Allocate physical memory from the given zone and track it as a PMM allocation
+// Allocate physical memory from the given zone
 unsigned long
 malloc_palloc(struct zone_s *zone, u32 size, u32 align)
 {
-    unsigned long data;
-
     ASSERT32FLAT();
     if (!size)
         return 0;
 
-    stackptr = (stackptr + align-1) & ~(align-1);
-    data = stackptr;
-    stackptr += size;
+    zone = zone_select(zone, align);
+    void *data = zone_alloc(zone, size, align);
+    if (!data)
+        warn_noalloc();
 
-    dprintf(8, "size=%d align=%d ret=0x%lx\n" , size, align, data);
+    dprintf(8, "%s size=%d align=%d ret=%p\n", zone->name, size, align, data);
 
-    return data;
+    return (unsigned long)data;
 }
 
 // Allocate virtual memory from the given zone
 void * __malloc
-parisc_malloc(u32 size, u32 align)
+parisc_malloc(struct zone_s *zone, u32 size, u32 align)
 {
-    return (void*) malloc_palloc(NULL, size, align);
+    return (void*) malloc_palloc(zone, size, align);
 }
 
 // Free a data block allocated with phys_alloc
 int
-malloc_pfree(u32 data)
+malloc_pfree(unsigned long data)
 {
+    if (!data)
+        return -1;
+    struct allocblk_s *blk = (void*)data - sizeof(*blk);
+    if (blk->magic != ALLOC_MAGIC_USED) {
+        dprintf(1, "WARNING: free of invalid pointer 0x%lx\n", data);
+        return -1;
+    }
+    struct zone_s *zone = blk->zone;
+    zone->frees++;
+    zone->live -= blk->size;
+    blk_release(blk);
     return 0;
 }
 
 void
 free(void *data)
 {
+    if (data)
+        malloc_pfree((unsigned long)data);
 }
 
+// Report peak and live bytes of each zone.
+void
+malloc_show_stats(void)
+{
+    int i;
+    for (i=0; i<ARRAY_SIZE(Zones); i++) {
+        struct zone_s *zone = Zones[i];
+        dprintf(1, "malloc %s: arena=%d live=%d peak=%d allocs=%d frees=%d\n"
+                , zone->name, zone->arena_size, zone->live, zone->peak
+                , zone->allocs, zone->frees);
+    }
+    dprintf(1, "malloc heap used %ld of %ld bytes\n"
+            , heap_cur - ALIGN((unsigned long)&_ebss, PAGE_SIZE)
+            , heap_end - ALIGN((unsigned long)&_ebss, PAGE_SIZE));
+}
 
 
 /****************************************************************
@@ -70,8 +327,8 @@ malloc_preinit(void)
 {
     ASSERT32FLAT();
     dprintf(3, "malloc preinit\n");
-    extern u8 _ebss;
-    stackptr = (unsigned long) &_ebss;
+    heap_cur = (unsigned long) &_ebss;
+    heap_end = FIRMWARE_END;
 }
 
 u32 LegacyRamSize VARFSEG;
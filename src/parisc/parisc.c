@@ -12,6 +12,7 @@
 #include "string.h" // memset
 #include "util.h" // serial_setup
 #include "malloc.h" // malloc
+#include "pollwait.h" // pollwait_show_stats
 #include "hw/serialio.h" // qemu_debug_port
 #include "hw/pcidevice.h" // foreachpci
 #include "hw/pci.h" // pci_config_readl
@@ -19,7 +20,10 @@
 #include "hw/pci_regs.h" // PCI_BASE_ADDRESS_0
 #include "hw/ata.h"
 #include "hw/blockcmd.h" // scsi_is_ready()
+#include "hw/lsi-scsi.h" // lsi_scsi_probe_lun
 #include "hw/rtc.h"
+#include "list.h" // hlist_node
+#include "romfile.h" // romfile_loadint
 #include "fw/paravirt.h" // PlatformRunningOn
 #include "vgahw.h"
 #include "parisc/hppa_hardware.h" // DINO_UART_BASE
@@ -36,6 +40,8 @@ int HaveRunPost;
 u8 ExtraStack[BUILD_EXTRA_STACK_SIZE+1] __aligned(8);
 u8 *StackPos;
 u8 __VISIBLE parisc_stack[32*1024] __aligned(64);
+/* PDC and IODC calls run on a private stack per CPU, see head.S */
+u8 __VISIBLE pdc_stacks[HPPA_MAX_CPUS][1 << PDC_STACK_SHIFT] __aligned(64);
 
 u8 BiosChecksum;
 
@@ -60,11 +66,8 @@ u16  get_pnp_offset(void) { return 0; }
 void mathcp_setup(void) { }
 void smp_setup(void) { }
 void bios32_init(void) { }
-void yield_toirq(void) { }
 void farcall16(struct bregs *callregs) { }
 void farcall16big(struct bregs *callregs) { }
-void mutex_lock(struct mutex_s *mutex) { }
-void mutex_unlock(struct mutex_s *mutex) { }
 void start_preempt(void) { }
 void finish_preempt(void) { }
 int wait_preempt(void) { return 0; }
@@ -92,13 +95,34 @@ extern unsigned long boot_args[];
 #define initrd_end		(boot_args[4])
 #define smp_cpus		(boot_args[5])
 #define pdc_debug		0 // (boot_args[6])
+#define pdc_stats_dump		(boot_args[6] & 2)
 
+extern u32 smp_wakeups[HPPA_MAX_CPUS];
 extern char pdc_entry;
-extern char pdc_entry_table[12];
+extern char pdc_entry_table[];
 extern char iodc_entry[512];
 extern char iodc_entry_table;
 
+/* size of the load_fw of an entry address in head.S, which the IODC entry
+ * table entries and the low memory PDC entry stub are made of */
+#define LOAD_FW_SIZE	((CONFIG_64BIT ? 3 : 2) * sizeof(unsigned int))
+#define PDC_ENTRY_TABLE_SIZE	(LOAD_FW_SIZE + sizeof(unsigned int))
+
 /* args as handed over for firmware calls */
+#if CONFIG_64BIT
+/* wide mode: pdc_entry/iodc_entry store the register args in order */
+typedef unsigned long pdc_arg_t;
+#define ARG0 arg[0]
+#define ARG1 arg[1]
+#define ARG2 arg[2]
+#define ARG3 arg[3]
+#define ARG4 arg[4]
+#define ARG5 arg[5]
+#define ARG6 arg[6]
+#define ARG7 arg[7]
+#define ARG8 arg[7]     /* stack args are not passed on, use reqsize */
+#else
+typedef unsigned int pdc_arg_t;
 #define ARG0 arg[7-0]
 #define ARG1 arg[7-1]
 #define ARG2 arg[7-2]
@@ -107,6 +131,40 @@ extern char iodc_entry_table;
 #define ARG5 arg[7-5]
 #define ARG6 arg[7-6]
 #define ARG7 arg[7-7]
+#define ARG8 arg[7-8]
+#endif
+
+/* firmware private PDC procedure to read the PDC call statistics */
+#define PDC_SEABIOS_STATS	0x5342
+#define PDC_SEABIOS_STATS_INFO	0	/* ret[0] = entries, ret[1] = entry size */
+#define PDC_SEABIOS_STATS_READ	1	/* copy used entries to ARG3, ARG4 bytes */
+#define PDC_SEABIOS_STATS_PRINT	2	/* dump all statistics to the console */
+#define PDC_SEABIOS_STATS_RESET	3
+#define PDC_SEABIOS_STATS_BOOTPROF 4	/* ret[0] = &boot_profile, ret[1] = size */
+
+/* proc of the statistics entries of IODC entry point n (ENTRY_INIT = 0) */
+#define PDC_SEABIOS_STATS_IODC	0x100
+
+struct pdc_stat_entry {
+    u32 proc, option;
+    u32 calls, max_cycles;
+    u64 cycles;
+};
+
+/* call count and interval timer cycles spent per proc and option */
+struct pdc_stat_s {
+    u32 calls;
+    u32 max_cycles;
+    u64 cycles;
+};
+
+static void pdc_stat_add(struct pdc_stat_s *st, unsigned long cycles)
+{
+    st->calls++;
+    st->cycles += cycles;
+    if (cycles > st->max_cycles)
+        st->max_cycles = cycles;
+}
 
 /* size of I/O block used in HP firmware */
 #define FW_BLOCKSIZE    2048
@@ -117,12 +175,19 @@ extern char iodc_entry_table;
 
 static unsigned long GoldenMemory = MIN_RAM_SIZE;
 
+/* RAM at RAM_HIGH_START, which didn't fit below FIRMWARE_START */
+static unsigned long ram_size_high;
+
 static unsigned int chassis_code = 0;
 
+static void parisc_show_stats(void);
+
 void __VISIBLE __noreturn hlt(void)
 {
     if (pdc_debug)
         printf("HALT initiated from %p\n",  __builtin_return_address(0));
+    if (pdc_stats_dump)
+        parisc_show_stats();
     printf("SeaBIOS wants SYSTEM HALT.\n\n");
     asm volatile("\t.word 0xfffdead0": : :"memory");
     while (1);
@@ -132,6 +197,8 @@ void __noreturn reset(void)
 {
     if (pdc_debug)
         printf("RESET initiated from %p\n",  __builtin_return_address(0));
+    if (pdc_stats_dump)
+        parisc_show_stats();
     printf("SeaBIOS wants SYSTEM RESET.\n"
             "***************************\n");
     PAGE0->imm_soft_boot = 1;
@@ -144,24 +211,53 @@ void __noreturn reset(void)
     if (unlikely(cond)) \
 { printf("ERROR in %s:%d\n", __FUNCTION__, __LINE__); hlt(); }
 
+/*
+ * Cache geometry of the emulated machine as reported by PDC_CACHE.
+ * The firmware flushes its own writes with the same line sizes.
+ */
+static unsigned long cache_info[] = { PARISC_PDC_CACHE_INFO };
+#define machine_cache_info      ((struct pdc_cache_info *) &cache_info)
+
+/* Write back the D-cache and invalidate the I-cache for a range of memory */
 void flush_data_cache(char *start, size_t length)
 {
-    char *end = start + length;
+    unsigned long dline = machine_cache_info->dc_stride;
+    unsigned long iline = machine_cache_info->ic_stride;
+    unsigned long end = (unsigned long)start + length;
+    unsigned long addr;
 
-    do
-    {
-        asm volatile("fdc 0(%0)" : : "r" (start));
-        asm volatile("fic 0(%%sr0,%0)" : : "r" (start));
-        start += 16;
-    } while (start < end);
-    asm volatile("fdc 0(%0)" : : "r" (end));
+    if (!length)
+        return;
+    for (addr = (unsigned long)start & ~(dline-1); addr < end; addr += dline)
+        asm volatile("fdc 0(%0)" : : "r" (addr));
+    asm volatile("sync");
+    for (addr = (unsigned long)start & ~(iline-1); addr < end; addr += iline)
+        asm volatile("fic 0(%%sr0,%0)" : : "r" (addr));
+    asm volatile("sync");
+}
 
-    asm ("sync");
+/* Flush both caches completely with the loops described by PDC_CACHE_INFO */
+static void flush_cache_all(void)
+{
+    struct pdc_cache_info *ci = machine_cache_info;
+    unsigned long addr, i, j;
+
+    addr = ci->dc_base;
+    for (i = 0; i < ci->dc_count; i++, addr += ci->dc_stride)
+        for (j = 0; j < ci->dc_loop; j++)
+            asm volatile("fdce 0(%0)" : : "r" (addr));
+    asm volatile("sync");
+
+    addr = ci->ic_base;
+    for (i = 0; i < ci->ic_count; i++, addr += ci->ic_stride)
+        for (j = 0; j < ci->ic_loop; j++)
+            asm volatile("fice 0(%%sr0,%0)" : : "r" (addr));
+    asm volatile("sync");
 }
 
 void memdump(void *mem, unsigned long len)
 {
-    printf("memdump @ 0x%x : ", (unsigned int) mem);
+    printf("memdump @ %p : ", mem);
     while (len--) {
         printf("0x%x ", (unsigned int) *(unsigned char *)mem);
         mem++;
@@ -169,6 +265,182 @@ void memdump(void *mem, unsigned long len)
     printf("\n");
 }
 
+/********************************************************
+ * Threads
+ ********************************************************/
+
+// Thread info - stored at the bottom of each thread stack.  The stack
+// grows upwards on PA-RISC and starts right behind this struct.
+struct thread_info {
+    void *stackpos;
+    struct hlist_node node;
+    void (*func)(void *);
+    void *data;
+};
+struct thread_info MainThread = {
+    NULL, { &MainThread.node, &MainThread.node.next }
+};
+#define THREADSTACKSIZE (16*1024)
+
+static u8 ThreadControl;
+
+// head.S
+extern void __switch_thread(void **save_sp, void *load_sp);
+extern void __start_thread(void **save_sp, void *stack,
+                           struct thread_info *thread);
+extern void __noreturn __exit_thread(void *main_sp,
+                                     struct thread_info *thread);
+
+// Check if any threads are running.
+static int
+have_threads(void)
+{
+    return (CONFIG_THREADS && MainThread.node.next != &MainThread.node);
+}
+
+// Return the 'struct thread_info' for the currently running thread.
+struct thread_info *
+getCurThread(void)
+{
+    unsigned long sp;
+    asm volatile("copy %%sp,%0" : "=r" (sp));
+    if (!have_threads()
+        || (sp >= (unsigned long)parisc_stack
+            && sp < (unsigned long)parisc_stack + sizeof(parisc_stack)))
+        return &MainThread;
+    return (void*)ALIGN_DOWN(sp, THREADSTACKSIZE);
+}
+
+// Initialize the support for internal threads.
+void
+thread_setup(void)
+{
+    if (! CONFIG_THREADS)
+        return;
+    ThreadControl = 1;
+}
+
+// Threads only run during POST, on parisc_stack.  Firmware calls of the OS
+// run on the per-CPU PDC stacks, which getCurThread() doesn't know about, so
+// device scans from there have to run their probes inline.
+static void
+thread_teardown(void)
+{
+    wait_threads();
+    ThreadControl = 0;
+}
+
+int
+threads_during_optionroms_check(void)
+{
+    return 0;
+}
+
+// Switch to next thread stack.
+static void
+switch_next(struct thread_info *cur)
+{
+    struct thread_info *next = container_of(
+        cur->node.next, struct thread_info, node);
+    if (cur == next)
+        // Nothing to do.
+        return;
+    __switch_thread(&cur->stackpos, next->stackpos);
+}
+
+// First function called on a new thread stack (from __start_thread).
+void __VISIBLE __noreturn
+parisc_thread_main(struct thread_info *thread)
+{
+    thread->func(thread->data);
+    __exit_thread(MainThread.stackpos, thread);
+}
+
+// Last thing called from a thread (called on MainThread stack).
+// Returns the stack position of the thread to continue with.
+void * __VISIBLE
+parisc_end_thread(struct thread_info *old)
+{
+    struct thread_info *next = container_of(
+        old->node.next, struct thread_info, node);
+    hlist_del(&old->node);
+    dprintf(DEBUG_thread, "\\%p/ End thread\n", old);
+    free(old);
+    if (!have_threads())
+        dprintf(1, "All threads complete.\n");
+    return next->stackpos;
+}
+
+// Create a new thread and start executing 'func' in it.
+void
+run_thread(void (*func)(void*), void *data)
+{
+    ASSERT32FLAT();
+    if (! CONFIG_THREADS || ! ThreadControl)
+        goto fail;
+    struct thread_info *thread;
+    thread = memalign_tmphigh(THREADSTACKSIZE, THREADSTACKSIZE);
+    if (!thread)
+        goto fail;
+
+    dprintf(DEBUG_thread, "/%p\\ Start thread\n", thread);
+    thread->func = func;
+    thread->data = data;
+    struct thread_info *cur = getCurThread();
+    hlist_add_after(&thread->node, &cur->node);
+    __start_thread(&cur->stackpos
+                   , (void*)ALIGN((unsigned long)(thread + 1), 64), thread);
+    return;
+
+fail:
+    func(data);
+}
+
+// Switch to the next thread, if there are any.
+void
+yield(void)
+{
+    if (!have_threads())
+        return;
+    switch_next(getCurThread());
+}
+
+// There are no interrupts to wait for during POST.
+void
+yield_toirq(void)
+{
+    yield();
+}
+
+// Wait for all threads (other than the main thread) to complete.
+void
+wait_threads(void)
+{
+    ASSERT32FLAT();
+    while (have_threads())
+        yield();
+}
+
+void
+mutex_lock(struct mutex_s *mutex)
+{
+    ASSERT32FLAT();
+    if (! CONFIG_THREADS)
+        return;
+    while (mutex->isLocked)
+        yield();
+    mutex->isLocked = 1;
+}
+
+void
+mutex_unlock(struct mutex_s *mutex)
+{
+    ASSERT32FLAT();
+    if (! CONFIG_THREADS)
+        return;
+    mutex->isLocked = 0;
+}
+
 /********************************************************
  * Boot drives
  ********************************************************/
@@ -182,6 +454,23 @@ static struct pdc_module_path mod_path_emulated_drives = {
     .layers = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 } // first two layer entries get replaced
 };
 
+/* All block devices enumerated; only the boot LUN is known after a fast boot */
+static int full_scan_done;
+static spinlock_t full_scan_lock = SPIN_LOCK_UNLOCKED;
+
+static void parisc_full_scan(void)
+{
+    if (full_scan_done)
+        return;
+    spin_lock(&full_scan_lock);
+    if (!full_scan_done) {
+        block_setup();
+        wait_threads();
+        full_scan_done = 1;
+    }
+    spin_unlock(&full_scan_lock);
+}
+
 /********************************************************
  * FIRMWARE IO Dependent Code (IODC) HANDLER
  ********************************************************/
@@ -195,7 +484,13 @@ typedef struct {
     int add_addr[5];
 } hppa_device_t;
 
-static hppa_device_t parisc_devices[HPPA_MAX_CPUS+16] = { PARISC_DEVICE_LIST };
+/* The machine list plus one entry for each additional CPU */
+#define PARISC_DEVICE_SLOTS     (HPPA_MAX_CPUS + 16)
+
+static hppa_device_t parisc_devices[PARISC_DEVICE_SLOTS] = { PARISC_DEVICE_LIST };
+
+/* HPA of the memory module in PARISC_DEVICE_LIST, moved to MEMORY_HPA */
+#define B160L_MEMORY_HPA        0xfffbf000
 
 #define PARISC_KEEP_LIST \
     GSC_HPA,\
@@ -203,7 +498,7 @@ static hppa_device_t parisc_devices[HPPA_MAX_CPUS+16] = { PARISC_DEVICE_LIST };
     DINO_UART_HPA,\
     /* DINO_SCSI_HPA, */ \
     CPU_HPA,\
-    MEMORY_HPA,\
+    B160L_MEMORY_HPA,\
     0
 
 static const char *hpa_name(unsigned long hpa)
@@ -232,9 +527,10 @@ static const char *hpa_name(unsigned long hpa)
 
     /* could be one of the SMP CPUs */
     for (i = 1; i < smp_cpus; i++) {
-        static char CPU_TXT[] = "CPU_HPA_x";
+        static char CPU_TXT[] = "CPU_HPA_xx";
         if (hpa == (CPU_HPA + i*0x1000)) {
-            CPU_TXT[8] = '0'+i;
+            CPU_TXT[8] = '0' + i / 10;
+            CPU_TXT[9] = '0' + i % 10;
             return CPU_TXT;
         }
     }
@@ -266,6 +562,54 @@ int HPA_is_storage_device(unsigned long hpa)
 }
 
 
+/*
+ * The OS probes many HPAs and module paths while walking the busses.
+ * Both are looked up in open addressed hash tables which hold the index+1
+ * into parisc_devices[] and are built by remove_parisc_devices().
+ */
+#define DEV_HASH_SIZE   128     /* power of 2, > 2*ARRAY_SIZE(parisc_devices) */
+
+static u8 hpa_hash[DEV_HASH_SIZE];
+static u8 path_hash[DEV_HASH_SIZE];
+
+static inline unsigned int hpa_hash_key(unsigned long hpa)
+{
+    return ((hpa >> 12) ^ (hpa >> 20)) & (DEV_HASH_SIZE-1);
+}
+
+static unsigned int path_hash_key(struct pdc_module_path *path)
+{
+    unsigned int i, key = path->path.mod;
+
+    for (i = 0; i < ARRAY_SIZE(path->path.bc); i++)
+        key = key * 31 + path->path.bc[i];
+    return (key ^ (key >> 7)) & (DEV_HASH_SIZE-1);
+}
+
+/* keep a free slot in the tables, or the probe loops never end */
+_Static_assert(PARISC_DEVICE_SLOTS < DEV_HASH_SIZE, "DEV_HASH_SIZE too small");
+
+static void dev_hash_insert(u8 *hash, unsigned int key, int index)
+{
+    while (hash[key])
+        key = (key + 1) & (DEV_HASH_SIZE-1);
+    hash[key] = index + 1;
+}
+
+static void build_parisc_device_index(void)
+{
+    int i;
+
+    memset(hpa_hash, 0, sizeof(hpa_hash));
+    memset(path_hash, 0, sizeof(path_hash));
+    for (i = 0; i < (ARRAY_SIZE(parisc_devices)-1); i++) {
+        if (!parisc_devices[i].hpa)
+            break;
+        dev_hash_insert(hpa_hash, hpa_hash_key(parisc_devices[i].hpa), i);
+        dev_hash_insert(path_hash, path_hash_key(parisc_devices[i].mod_path), i);
+    }
+}
+
 static int keep_this_hpa(unsigned long hpa)
 {
     static const unsigned long keep_list[] = { PARISC_KEEP_LIST };
@@ -285,7 +629,7 @@ static void remove_parisc_devices(unsigned int num_cpus)
 {
     static struct pdc_system_map_mod_info modinfo[HPPA_MAX_CPUS] = { {1,}, };
     static struct pdc_module_path modpath[HPPA_MAX_CPUS] = { {{1,}} };
-    hppa_device_t *cpu_dev = NULL;
+    hppa_device_t *cpu_dev = NULL, *mem_dev = NULL;
     unsigned long hpa;
     int i, p, t;
 
@@ -301,6 +645,8 @@ static void remove_parisc_devices(unsigned int num_cpus)
             parisc_devices[t] = parisc_devices[p];
             if (hpa == CPU_HPA)
                 cpu_dev = &parisc_devices[t];
+            if (hpa == B160L_MEMORY_HPA)
+                mem_dev = &parisc_devices[t];
             t++;
         }
         p++;
@@ -311,6 +657,12 @@ static void remove_parisc_devices(unsigned int num_cpus)
     cpu_dev->mod_info->mod_addr = CPU_HPA;
     cpu_dev->mod_path->path.mod = (CPU_HPA - DINO_HPA) / 0x1000;
 
+    /* Move the memory module out of the way of CPU 15 */
+    BUG_ON(!mem_dev);
+    mem_dev->hpa = MEMORY_HPA;
+    mem_dev->mod_info->mod_addr = MEMORY_HPA;
+    mem_dev->mod_path->path.mod = (MEMORY_HPA - DINO_HPA) / 0x1000;
+
     /* Generate other CPU devices */
     for (i = 1; i < num_cpus; i++) {
         unsigned long hpa = CPU_HPA + i*0x1000;
@@ -331,22 +683,25 @@ static void remove_parisc_devices(unsigned int num_cpus)
 
     BUG_ON(t > ARRAY_SIZE(parisc_devices));
 
-    while (t < ARRAY_SIZE(parisc_devices)) {
+    while (t < PARISC_DEVICE_SLOTS) {
         memset(&parisc_devices[t], 0, sizeof(parisc_devices[0]));
         t++;
     }
+
+    build_parisc_device_index();
 }
 
 static int find_hpa_index(unsigned long hpa)
 {
+    unsigned int key;
     int i;
+
     if (!hpa)
         return -1;
-    for (i = 0; i < (ARRAY_SIZE(parisc_devices)-1); i++) {
-        if (hpa == parisc_devices[i].hpa)
-            return i;
-        if (!parisc_devices[i].hpa)
-            return -1;
+    for (key = hpa_hash_key(hpa); (i = hpa_hash[key]) != 0;
+         key = (key + 1) & (DEV_HASH_SIZE-1)) {
+        if (hpa == parisc_devices[i-1].hpa)
+            return i-1;
     }
     return -1;
 }
@@ -375,41 +730,474 @@ static hppa_device_t *find_hppa_device_by_path(struct pdc_module_path *search,
                                                unsigned long *index)
 {
     hppa_device_t *dev;
+    unsigned int key;
     int i;
 
-    for (i = 0; i < (ARRAY_SIZE(parisc_devices)-1); i++) {
-        dev = parisc_devices + i;
-        if (!dev->hpa)
-            continue;
-
+    for (key = path_hash_key(search); (i = path_hash[key]) != 0;
+         key = (key + 1) & (DEV_HASH_SIZE-1)) {
+        dev = parisc_devices + i-1;
         if (!compare_module_path(dev->mod_path, search)) {
-            *index = i;
+            *index = i-1;
             return dev;
         }
     }
     return NULL;
 }
 
-#define SERIAL_TIMEOUT 20
-static unsigned long parisc_serial_in(char *c, unsigned long maxchars)
+/* The linear scans which were used before the index, as reference. */
+static int find_hpa_index_linear(unsigned long hpa)
 {
-    const portaddr_t addr = DINO_UART_HPA+0x800;
-    unsigned long end = timer_calc(SERIAL_TIMEOUT);
-    unsigned long count = 0;
-    while (count < maxchars) {
-        u8 lsr = inb(addr+SEROFF_LSR);
-        if (lsr & 0x01) {
-            // Success - can read data
-            *c++ = inb(addr+SEROFF_DATA);
-            count++;
+    int i;
+
+    for (i = 0; i < (ARRAY_SIZE(parisc_devices)-1); i++) {
+        if (!parisc_devices[i].hpa)
+            break;
+        if (hpa == parisc_devices[i].hpa)
+            return i;
+    }
+    return -1;
+}
+
+static int find_path_index_linear(struct pdc_module_path *search)
+{
+    int i;
+
+    for (i = 0; i < (ARRAY_SIZE(parisc_devices)-1); i++) {
+        if (!parisc_devices[i].hpa)
+            break;
+        if (!compare_module_path(parisc_devices[i].mod_path, search))
+            return i;
+    }
+    return -1;
+}
+
+/* Replay the probes of an OS bus walk with the index and with linear
+ * scans, check that both agree and print the cycles they take:
+ * PDC_IODC on every page of the central bus, Lasi and the graphics
+ * slots, then PDC_SYSTEM_MAP_TRANS_PATH for every device and for all
+ * module numbers on the bus of the first device. */
+static void dev_index_bench(void)
+{
+    static const struct { unsigned long hpa, pages; } ranges[] = {
+        { DINO_HPA, 128 }, { LASI_HPA, 16 }, { LASI_GFX_HPA, 1 },
+        { IDE_HPA, 1 }, { GSC_HPA, 1 },
+    };
+    struct pdc_module_path path;
+    unsigned long index;
+    hppa_device_t *dev;
+    u64 start, hashed = 0, linear = 0;
+    int probes = 0, errors = 0, r, p, i, idx;
+
+    for (r = 0; r < ARRAY_SIZE(ranges); r++)
+        for (p = 0; p < ranges[r].pages; p++) {
+            unsigned long hpa = ranges[r].hpa + p * 0x1000;
+            start = timer_read64();
+            idx = find_hpa_index(hpa);
+            hashed += timer_read64() - start;
+            start = timer_read64();
+            errors += (idx != find_hpa_index_linear(hpa));
+            linear += timer_read64() - start;
+            probes++;
+        }
+
+    for (i = 0; i < PARISC_DEVICE_SLOTS + 64; i++) {
+        if (i < PARISC_DEVICE_SLOTS) {
+            if (!parisc_devices[i].hpa)
+                continue;
+            path = *parisc_devices[i].mod_path;
+        } else {
+            /* modules on the bus of the first device, most don't exist */
+            path = *parisc_devices[0].mod_path;
+            path.path.mod = i - PARISC_DEVICE_SLOTS;
         }
-        if (timer_check(end))
+        start = timer_read64();
+        dev = find_hppa_device_by_path(&path, &index);
+        idx = dev ? index : -1;
+        hashed += timer_read64() - start;
+        start = timer_read64();
+        errors += (idx != find_path_index_linear(&path));
+        linear += timer_read64() - start;
+        probes++;
+    }
+
+    dprintf(1, "device index: %d probes, %d mismatches, index %llu cycles,"
+            " linear scan %llu cycles\n", probes, errors, hashed, linear);
+}
+
+/********************************************************
+ * Boot medium block cache
+ ********************************************************/
+
+/*
+ * Boot loaders read the boot medium with many small, repeated and
+ * overlapping ENTRY_IO_BOOTIN requests.  Keep recently read
+ * FW_BLOCKSIZE blocks in a LRU cache, keyed by drive and block number.
+ */
+
+#define BCACHE_MIN_SIZE         (64*1024)
+#define BCACHE_MAX_SIZE         (2*1024*1024)
+#define BCACHE_HASH_SIZE        256
+
+struct bcache_entry {
+    struct hlist_node node;             // hash chain
+    struct bcache_entry *prev, *next;   // LRU list, most recent first
+    struct drive_s *drive;              // NULL if unused
+    u32 block;
+    u8 *data;
+};
+
+static struct {
+    struct hlist_head hash[BCACHE_HASH_SIZE];
+    struct bcache_entry lru;
+    u32 count;
+    u32 hits, misses, evictions, bypassed;
+} bcache;
+
+static inline struct hlist_head *
+bcache_bucket(struct drive_s *drive, u32 block)
+{
+    u32 key = block ^ ((unsigned long)drive >> 4);
+    return &bcache.hash[key % BCACHE_HASH_SIZE];
+}
+
+static void
+bcache_lru_del(struct bcache_entry *e)
+{
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+}
+
+static void
+bcache_lru_add(struct bcache_entry *e)
+{
+    e->next = bcache.lru.next;
+    e->prev = &bcache.lru;
+    e->next->prev = e;
+    bcache.lru.next = e;
+}
+
+static struct bcache_entry *
+bcache_lookup(struct drive_s *drive, u32 block)
+{
+    struct bcache_entry *e;
+    hlist_for_each_entry(e, bcache_bucket(drive, block), node) {
+        if (e->drive == drive && e->block == block)
+            return e;
+    }
+    return NULL;
+}
+
+// Get the entry for a block, replacing the least recently used one.
+static struct bcache_entry *
+bcache_claim(struct drive_s *drive, u32 block)
+{
+    struct bcache_entry *e = bcache_lookup(drive, block);
+    if (!e) {
+        e = bcache.lru.prev;
+        if (e->drive) {
+            hlist_del(&e->node);
+            bcache.evictions++;
+        }
+        e->drive = drive;
+        e->block = block;
+        hlist_add_head(&e->node, bcache_bucket(drive, block));
+    }
+    bcache_lru_del(e);
+    bcache_lru_add(e);
+    return e;
+}
+
+// Drop an entry whose data could not be read.  It becomes the least
+// recently used entry, so it is reused first.
+static void
+bcache_invalidate(struct bcache_entry *e)
+{
+    hlist_del(&e->node);
+    e->drive = NULL;
+    bcache_lru_del(e);
+    e->next = &bcache.lru;
+    e->prev = bcache.lru.prev;
+    e->prev->next = e;
+    bcache.lru.prev = e;
+}
+
+// Store a block in the cache.
+static void
+bcache_insert(struct drive_s *drive, u32 block, void *data)
+{
+    struct bcache_entry *e = bcache_claim(drive, block);
+    memcpy(e->data, data, FW_BLOCKSIZE);
+}
+
+static void
+bcache_setup(void)
+{
+    struct bcache_entry *entries;
+    u8 *data;
+    u32 size, i;
+
+    bcache.lru.next = bcache.lru.prev = &bcache.lru;
+
+    // Use 1/64 of the RAM which is available to the OS.
+    size = (ram_size - PAGE0->mem_free) / 64;
+    if (size > BCACHE_MAX_SIZE)
+        size = BCACHE_MAX_SIZE;
+    for (; size >= BCACHE_MIN_SIZE; size /= 2) {
+        bcache.count = size / FW_BLOCKSIZE;
+        data = memalign_high(FW_BLOCKSIZE, size);
+        entries = malloc_high(bcache.count * sizeof(*entries));
+        if (data && entries)
             break;
+        free(data);
+        free(entries);
+        bcache.count = 0;
+    }
+    if (!bcache.count) {
+        dprintf(1, "parisc: no memory for boot block cache\n");
+        return;
+    }
+
+    memset(entries, 0, bcache.count * sizeof(*entries));
+    for (i = 0; i < bcache.count; i++) {
+        entries[i].data = data + i * FW_BLOCKSIZE;
+        bcache_lru_add(&entries[i]);
     }
+    dprintf(1, "parisc: boot block cache with %d blocks of %d bytes\n"
+            , bcache.count, FW_BLOCKSIZE);
+}
+
+// Read 'len' bytes at byte offset 'offset' from the boot medium.
+static int
+boot_medium_read(struct drive_s *drive, u32 offset, void *buf, u32 len)
+{
+    struct disk_op_s disk_op;
+
+    memset(&disk_op, 0, sizeof(disk_op));
+    disk_op.drive_fl = drive;
+    disk_op.buf_fl = buf;
+    disk_op.command = CMD_READ;
+    disk_op.count = (len / drive->blksize);
+    disk_op.lba = (offset / drive->blksize);
+    return process_op(&disk_op);
+}
+
+/*
+ * Kernel and ramdisk are loaded with long runs of sequential
+ * ENTRY_IO_BOOTIN calls.  Track such streams per drive and read ahead
+ * of them with a window which doubles on every sequential access.
+ * Read-ahead blocks go into the spare room of the caller's buffer (up
+ * to ARG8 maxsize) and then into the cache.  Otherwise they are read
+ * straight into cache entries with one vectored request, or into a
+ * staging buffer if the driver takes fewer segments than that.
+ */
+
+#define RA_STREAMS              4
+#define RA_MIN_BLOCKS           8
+#define RA_MAX_BLOCKS           128
+
+static struct ra_stream {
+    struct drive_s *drive;
+    u32 next;           // block expected next if the stream continues
+    u32 window;         // read-ahead window in blocks, 0 if not sequential
+    u32 used;           // ra_clock at the last access
+} ra_streams[RA_STREAMS];
+static u32 ra_clock;
+static struct disk_iovec_s ra_iov[RA_MAX_BLOCKS];
+static u8 *ra_buf;
+static u32 ra_max, ra_blocks;
+
+static void
+ra_setup(void)
+{
+    if (!bcache.count)
+        return;
+    ra_max = bcache.count / 4;
+    if (ra_max > RA_MAX_BLOCKS)
+        ra_max = RA_MAX_BLOCKS;
+    if (ra_max < RA_MIN_BLOCKS) {
+        ra_max = 0;
+        return;
+    }
+    ra_buf = memalign_high(FW_BLOCKSIZE, ra_max * FW_BLOCKSIZE);
+    if (!ra_buf)
+        ra_max = 0;
+}
+
+// Return the read-ahead window for a request of 'nblocks' at 'block'.
+static u32
+ra_update(struct drive_s *drive, u32 block, u32 nblocks)
+{
+    struct ra_stream *s = NULL;
+    int i;
+
+    if (!ra_max)
+        return 0;
+    // continue a stream, small forward skips keep its window
+    for (i = 0; i < RA_STREAMS; i++)
+        if (ra_streams[i].drive == drive && block >= ra_streams[i].next
+            && block <= ra_streams[i].next + ra_streams[i].window) {
+            s = &ra_streams[i];
+            break;
+        }
+    if (!s) {
+        // start a new stream in the least recently used slot
+        s = &ra_streams[0];
+        for (i = 1; i < RA_STREAMS; i++)
+            if (ra_streams[i].used < s->used)
+                s = &ra_streams[i];
+        s->drive = drive;
+        s->window = 0;
+    } else if (block == s->next) {
+        if (!s->window)
+            s->window = RA_MIN_BLOCKS;
+        else if (s->window < ra_max)
+            s->window *= 2;
+    }
+    if (s->window > ra_max)
+        s->window = ra_max;
+    s->next = block + nblocks;
+    s->used = ++ra_clock;
+
+    // don't read behind the end of the medium
+    u64 end = drive->sectors * drive->blksize / FW_BLOCKSIZE;
+    if (drive->sectors && block + nblocks + s->window > end)
+        return (block + nblocks < end) ? end - block - nblocks : 0;
+    return s->window;
+}
+
+// Prefetch up to 'count' blocks starting at 'block' into the cache.
+static void
+ra_prefetch(struct drive_s *drive, u32 block, u32 count)
+{
+    while (count && bcache_lookup(drive, block)) {
+        block++;
+        count--;
+    }
+    while (count && bcache_lookup(drive, block + count - 1))
+        count--;
+    if (!count)
+        return;
+
+    u32 i;
+    if (count > disk_iov_max(drive)) {
+        // more segments than the driver takes at once, stage the data
+        if (boot_medium_read(drive, block * FW_BLOCKSIZE, ra_buf
+                             , count * FW_BLOCKSIZE))
+            return;
+        ra_blocks += count;
+        for (i = 0; i < count; i++)
+            if (!bcache_lookup(drive, block + i))
+                bcache_insert(drive, block + i, ra_buf + i * FW_BLOCKSIZE);
+        return;
+    }
+
+    // read into the cache entries, count <= ra_max keeps them from
+    // replacing each other
+    u32 per_block = FW_BLOCKSIZE / drive->blksize;
+    for (i = 0; i < count; i++) {
+        ra_iov[i].buf_fl = bcache_claim(drive, block + i)->data;
+        ra_iov[i].count = per_block;
+    }
+    struct disk_op_s disk_op;
+    memset(&disk_op, 0, sizeof(disk_op));
+    disk_op.drive_fl = drive;
+    disk_op.buf_fl = ra_iov;
+    disk_op.command = CMD_READV;
+    disk_op.count = count * per_block;
+    disk_op.lba = block * per_block;
+    if (process_op(&disk_op)) {
+        for (i = 0; i < count; i++)
+            bcache_invalidate(bcache_lookup(drive, block + i));
+        return;
+    }
+    ra_blocks += count;
+}
+
+// Read from the boot medium through the block cache.  The caller's
+// buffer may be filled up to 'maxlen' bytes with read-ahead data.
+static int
+bcache_read(struct drive_s *drive, u32 offset, u8 *buf, u32 len, u32 maxlen)
+{
+    u32 block, nblocks, run, extra = 0, ra, room, i;
+    int ret;
+
+    if (!bcache.count || (offset % FW_BLOCKSIZE) || (len % FW_BLOCKSIZE)
+        || (FW_BLOCKSIZE % drive->blksize)) {
+        bcache.bypassed++;
+        return boot_medium_read(drive, offset, buf, len);
+    }
+
+    block = offset / FW_BLOCKSIZE;
+    nblocks = len / FW_BLOCKSIZE;
+    ra = ra_update(drive, block, nblocks);
+    room = (maxlen > len) ? (maxlen - len) / FW_BLOCKSIZE : 0;
+    while (nblocks) {
+        struct bcache_entry *e = bcache_lookup(drive, block);
+        if (e) {
+            memcpy(buf, e->data, FW_BLOCKSIZE);
+            bcache_lru_del(e);
+            bcache_lru_add(e);
+            bcache.hits++;
+            run = 1;
+            extra = 0;
+        } else {
+            // read all consecutive missing blocks with one request
+            run = 1;
+            while (run < nblocks && !bcache_lookup(drive, block + run))
+                run++;
+            // and extend it into the spare room of the caller's buffer
+            extra = 0;
+            if (run == nblocks)
+                while (extra < ra && extra < room
+                       && !bcache_lookup(drive, block + run + extra))
+                    extra++;
+            ret = boot_medium_read(drive, block * FW_BLOCKSIZE, buf
+                                   , (run + extra) * FW_BLOCKSIZE);
+            if (ret && extra) {
+                extra = 0;
+                ret = boot_medium_read(drive, block * FW_BLOCKSIZE, buf
+                                       , run * FW_BLOCKSIZE);
+            }
+            if (ret)
+                return ret;
+            bcache.misses += run;
+            ra_blocks += extra;
+            i = (run + extra > bcache.count) ? run + extra - bcache.count : 0;
+            for (; i < run + extra; i++)
+                bcache_insert(drive, block + i, buf + i * FW_BLOCKSIZE);
+        }
+        block += run;
+        buf += run * FW_BLOCKSIZE;
+        nblocks -= run;
+        ra -= extra;
+    }
+    if (ra)
+        ra_prefetch(drive, block + extra, ra);
+    return 0;
+}
+
+static void
+bcache_show_stats(void)
+{
+    dprintf(1, "parisc: boot block cache: %d hits, %d misses, %d evictions,"
+            " %d bypassed requests, %d blocks read ahead\n", bcache.hits
+            , bcache.misses, bcache.evictions, bcache.bypassed, ra_blocks);
+}
+
+#define SERIAL_TIMEOUT 20
+/* Return buffered input at once, otherwise wait for some until timeout. */
+static unsigned long parisc_serial_in(char *c, unsigned long maxchars)
+{
+    u64 end = timer_deadline_ms(SERIAL_TIMEOUT);
+    unsigned long count;
+
+    while (!(count = parisc_serial_read(c, maxchars)))
+        if (timer_expired(end))
+            break;
     return count;
 }
 
-void iodc_log_call(unsigned int *arg, const char *func)
+void iodc_log_call(pdc_arg_t *arg, const char *func)
 {
     if (pdc_debug) {
         printf("\nIODC %s called: hpa=0x%x (%s) option=0x%x arg2=0x%x arg3=0x%x ", func, ARG0, hpa_name(ARG0), ARG1, ARG2, ARG3);
@@ -421,15 +1209,57 @@ void iodc_log_call(unsigned int *arg, const char *func)
     int a0, int a1, int a2, int a3,  int a4,  int a5,  int a6, \
     int a7, int a8, int a9, int a10, int a11, int a12
 
+/* The 64-bit firmware passes 1 in a0 for calls from narrow mode */
+#define NARROW_CALL	(CONFIG_64BIT && a0 == 1)
+
+/*
+ * Narrow callers of the 64-bit firmware hand in a result buffer of 32-bit
+ * words.  Run the procedure on a buffer of longs and narrow the result
+ * afterwards.  The caller's words are copied in first, so the ones the
+ * procedure doesn't return keep their value.
+ */
+#define NARROW_RESULT_WORDS	32
+
+static int narrow_call(int (*func)(pdc_arg_t *arg), pdc_arg_t *arg
+                       , pdc_arg_t *res)
+{
+    unsigned int *narrow = (unsigned int *)*res;
+    unsigned long result[NARROW_RESULT_WORDS];
+    int i, ret;
+
+    if (!narrow)
+        return func(arg);
+    for (i = 0; i < NARROW_RESULT_WORDS; i++)
+        result[i] = narrow[i];
+    *res = (unsigned long)result;
+    ret = func(arg);
+    *res = (unsigned long)narrow;
+    for (i = 0; i < NARROW_RESULT_WORDS; i++)
+        narrow[i] = result[i];
+    return ret;
+}
+
+
+/*
+ * Firmware calls may arrive on several CPUs at once.  Only state which
+ * is shared between the CPUs is locked: the boot device with the block
+ * cache and the late device scan, and the storage areas.  The UART and its receive ring are locked
+ * in output.c, so printf() from any CPU is safe; iodc_console_lock only
+ * keeps a COUT buffer from being interleaved with another IODC caller.
+ */
+static spinlock_t iodc_console_lock = SPIN_LOCK_UNLOCKED;
+static spinlock_t iodc_boot_lock = SPIN_LOCK_UNLOCKED;
+static spinlock_t pdc_storage_lock = SPIN_LOCK_UNLOCKED;
+static spinlock_t pdc_tod_lock = SPIN_LOCK_UNLOCKED;
+spinlock_t pci_io_lock = SPIN_LOCK_UNLOCKED; /* Dino address latch, hppa.h */
 
-int __VISIBLE parisc_iodc_ENTRY_IO(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_io(pdc_arg_t *arg)
 {
     unsigned long hpa = ARG0;
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG4;
-    int ret, len;
+    int ret;
     char *c;
-    struct disk_op_s disk_op;
 
     if (1 &&
             ((HPA_is_serial_device(hpa) && option == ENTRY_IO_COUT) ||
@@ -444,14 +1274,16 @@ int __VISIBLE parisc_iodc_ENTRY_IO(unsigned int *arg FUNC_MANY_ARGS)
     if (HPA_is_serial_device(hpa))
         switch (option) {
             case ENTRY_IO_COUT: /* console output */
-                c = (char*)ARG6;
-                result[0] = len = ARG7;
-                while (len--)
-                    printf("%c", *c++);
+                result[0] = ARG7;
+                spin_lock(&iodc_console_lock);
+                parisc_screen_write((char*)ARG6, ARG7);
+                spin_unlock(&iodc_console_lock);
                 return PDC_OK;
             case ENTRY_IO_CIN: /* console input, with 5 seconds timeout */
                 c = (char*)ARG6;
+                spin_lock(&iodc_console_lock);
                 result[0] = parisc_serial_in(c, ARG7);
+                spin_unlock(&iodc_console_lock);
                 return PDC_OK;
         }
 
@@ -459,13 +1291,9 @@ int __VISIBLE parisc_iodc_ENTRY_IO(unsigned int *arg FUNC_MANY_ARGS)
     if (HPA_is_storage_device(hpa))
         switch (option) {
             case ENTRY_IO_BOOTIN: /* boot medium IN */
-                disk_op.drive_fl = boot_drive;
-                disk_op.buf_fl = (void*)ARG6;
-                disk_op.command = CMD_READ;
-                disk_op.count = (ARG7 / disk_op.drive_fl->blksize);
-                disk_op.lba = (ARG5 / disk_op.drive_fl->blksize);
-                // ARG8 = maxsize !!!
-                ret = process_op(&disk_op);
+                spin_lock(&iodc_boot_lock);
+                ret = bcache_read(boot_drive, ARG5, (void*)ARG6, ARG7, ARG8);
+                spin_unlock(&iodc_boot_lock);
                 // dprintf(0, "\nBOOT IO res %d count = %d\n", ret, ARG7);
                 result[0] = ARG7;
                 if (ret)
@@ -473,8 +1301,14 @@ int __VISIBLE parisc_iodc_ENTRY_IO(unsigned int *arg FUNC_MANY_ARGS)
                 return PDC_OK;
         }
 
-    if (option == ENTRY_IO_CLOSE)
+    if (option == ENTRY_IO_CLOSE) {
+        if (pdc_stats_dump && HPA_is_storage_device(hpa)) {
+            spin_lock(&iodc_boot_lock);
+            bcache_show_stats();
+            spin_unlock(&iodc_boot_lock);
+        }
         return PDC_OK;
+    }
 
     //	BUG_ON(1);
     iodc_log_call(arg, __FUNCTION__);
@@ -483,7 +1317,7 @@ int __VISIBLE parisc_iodc_ENTRY_IO(unsigned int *arg FUNC_MANY_ARGS)
 }
 
 
-int __VISIBLE parisc_iodc_ENTRY_INIT(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_init(pdc_arg_t *arg)
 {
     unsigned long hpa = ARG0;
     unsigned long option = ARG1;
@@ -496,6 +1330,13 @@ int __VISIBLE parisc_iodc_ENTRY_INIT(unsigned int *arg FUNC_MANY_ARGS)
     if (hpa_index < 0 && hpa != IDE_HPA)
         return PDC_INVALID_ARG;
 
+    /* the OS looks for boot devices, so find the ones fast boot skipped */
+    if (HPA_is_storage_device(hpa)) {
+        spin_lock(&iodc_boot_lock);
+        parisc_full_scan();
+        spin_unlock(&iodc_boot_lock);
+    }
+
     switch (option) {
         case ENTRY_INIT_MOD_DEV: /* 4: Init & test mod & dev */
         case ENTRY_INIT_DEV:     /* 5: Init & test dev */
@@ -511,19 +1352,19 @@ int __VISIBLE parisc_iodc_ENTRY_INIT(unsigned int *arg FUNC_MANY_ARGS)
     return PDC_BAD_OPTION;
 }
 
-int __VISIBLE parisc_iodc_ENTRY_SPA(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_spa(pdc_arg_t *arg)
 {
     iodc_log_call(arg, __FUNCTION__);
     return PDC_BAD_OPTION;
 }
 
-int __VISIBLE parisc_iodc_ENTRY_CONFIG(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_config(pdc_arg_t *arg)
 {
     iodc_log_call(arg, __FUNCTION__);
     return PDC_BAD_OPTION;
 }
 
-int __VISIBLE parisc_iodc_ENTRY_TEST(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_test(pdc_arg_t *arg)
 {
     unsigned long hpa = ARG0;
     unsigned long option = ARG1;
@@ -553,7 +1394,7 @@ int __VISIBLE parisc_iodc_ENTRY_TEST(unsigned int *arg FUNC_MANY_ARGS)
     return PDC_BAD_OPTION;
 }
 
-int __VISIBLE parisc_iodc_ENTRY_TLB(unsigned int *arg FUNC_MANY_ARGS)
+static int iodc_entry_tlb(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG4;
@@ -568,6 +1409,69 @@ int __VISIBLE parisc_iodc_ENTRY_TLB(unsigned int *arg FUNC_MANY_ARGS)
     return PDC_BAD_OPTION;
 }
 
+/*
+ * Call count and cycles of the IODC entry points, in the order of
+ * iodc_entry_table in head.S.  ENTRY_IO options go up to
+ * ENTRY_IO_BBLOCK_OUT, the last slot counts all higher options.
+ */
+#define IODC_ENTRIES            7
+#define IODC_STAT_OPTIONS       (ENTRY_IO_BBLOCK_OUT + 2)
+
+static const char * const iodc_entry_names[IODC_ENTRIES] = {
+    "ENTRY_INIT", "ENTRY_IO", "ENTRY_SPA", "ENTRY_CONFIG", "obsolete",
+    "ENTRY_TEST", "ENTRY_TLB",
+};
+
+static struct pdc_stat_s iodc_stats[IODC_ENTRIES][IODC_STAT_OPTIONS];
+
+static int iodc_call(int entry, int (*func)(pdc_arg_t *arg)
+                     , pdc_arg_t *arg, int narrow)
+{
+    unsigned long option = ARG1;
+    unsigned long start;
+    int ret;
+
+    start = rdtscll();
+    if (narrow)
+        ret = narrow_call(func, arg, &ARG4);
+    else
+        ret = func(arg);
+    pdc_stat_add(&iodc_stats[entry][(option < IODC_STAT_OPTIONS)
+                                    ? option : IODC_STAT_OPTIONS-1]
+                 , rdtscll() - start);
+    return ret;
+}
+
+int __VISIBLE parisc_iodc_ENTRY_INIT(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(0, iodc_entry_init, arg, NARROW_CALL);
+}
+
+int __VISIBLE parisc_iodc_ENTRY_IO(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(1, iodc_entry_io, arg, NARROW_CALL);
+}
+
+int __VISIBLE parisc_iodc_ENTRY_SPA(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(2, iodc_entry_spa, arg, NARROW_CALL);
+}
+
+int __VISIBLE parisc_iodc_ENTRY_CONFIG(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(3, iodc_entry_config, arg, NARROW_CALL);
+}
+
+int __VISIBLE parisc_iodc_ENTRY_TEST(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(5, iodc_entry_test, arg, NARROW_CALL);
+}
+
+int __VISIBLE parisc_iodc_ENTRY_TLB(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    return iodc_call(6, iodc_entry_tlb, arg, NARROW_CALL);
+}
+
 /********************************************************
  * FIRMWARE PDC HANDLER
  ********************************************************/
@@ -591,6 +1495,73 @@ static void init_stable_storage(void)
     stable_storage[0x5f] = 0x0f;
 }
 
+/*
+ * Both storage areas are kept across boots in writable fw_cfg files,
+ * if qemu provides them.  The firmware reads them at startup and writes
+ * every change through to the host.
+ */
+#define STABLE_STORAGE_FILE	"opt/hppa/stable-storage"
+#define NVOLATILE_STORAGE_FILE	"opt/hppa/nvolatile-storage"
+
+static struct romfile_s *stable_file, *nvolatile_file;
+static int stable_loaded;   /* stable storage holds the saved contents */
+
+static void storage_write(struct romfile_s *file, void *buf, u32 offset, u32 len)
+{
+    if (file && len)
+        qemu_cfg_write_file(buf + offset, file, offset, len);
+}
+
+/* Load a storage area from its file, or store the defaults into a new one */
+static struct romfile_s *storage_open(const char *name, void *buf, u32 size
+                                       , int *loaded)
+{
+    struct romfile_s *file = romfile_find(name);
+    u8 *data;
+    u32 i;
+
+    if (!file)
+        return NULL;
+    if (!qemu_cfg_dma_enabled() || file->size != size) {
+        dprintf(1, "parisc: cannot use %s of %d bytes\n", name, file->size);
+        return NULL;
+    }
+    data = malloc_tmp(size);
+    if (!data) {
+        warn_noalloc();
+        return NULL;
+    }
+    if (file->copy(file, data, size) == size)
+        for (i = 0; i < size; i++)
+            if (data[i]) {
+                memcpy(buf, data, size);
+                free(data);
+                *loaded = 1;
+                return file;
+            }
+    /* a new file is all zero */
+    free(data);
+    storage_write(file, buf, 0, size);
+    return file;
+}
+
+static void storage_setup(void)
+{
+    int nvolatile_loaded = 0;
+
+    init_stable_storage();
+    memset(nvolatile_storage, 0, sizeof(nvolatile_storage));
+    stable_file = storage_open(STABLE_STORAGE_FILE, stable_storage
+                               , STABLE_STORAGE_SIZE, &stable_loaded);
+    nvolatile_file = storage_open(NVOLATILE_STORAGE_FILE, nvolatile_storage
+                                  , NVOLATILE_STORAGE_SIZE, &nvolatile_loaded);
+    dprintf(1, "parisc: stable storage %s%s, non-volatile storage %s%s\n"
+            , stable_file ? "persistent" : "in RAM"
+            , stable_loaded ? " (loaded)" : ""
+            , nvolatile_file ? "persistent" : "in RAM"
+            , nvolatile_loaded ? " (loaded)" : "");
+}
+
 
 /*
  * Trivial time conversion helper functions.
@@ -733,7 +1704,7 @@ static const char *pdc_name(unsigned long num)
         return "UNKNOWN!";
 }
 
-static int pdc_chassis(unsigned int *arg)
+static int pdc_chassis(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -757,7 +1728,7 @@ static int pdc_chassis(unsigned int *arg)
     return PDC_BAD_PROC;
 }
 
-static int pdc_pim(unsigned int *arg)
+static int pdc_pim(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -778,7 +1749,7 @@ static int pdc_pim(unsigned int *arg)
     return PDC_BAD_PROC;
 }
 
-static int pdc_model(unsigned int *arg)
+static int pdc_model(pdc_arg_t *arg)
 {
     static unsigned long model[] = { PARISC_PDC_MODEL };
     static const char model_str[] = PARISC_MODEL;
@@ -808,6 +1779,8 @@ static int pdc_model(unsigned int *arg)
             return PDC_OK;
         case PDC_MODEL_CAPABILITIES:
             result[0] = PARISC_PDC_CAPABILITIES;
+            if (CONFIG_64BIT)
+                result[0] |= PDC_MODEL_OS64;
             return PDC_OK;
         case PDC_MODEL_GET_INSTALL_KERNEL:
             // No need to provide a special install kernel during installation of HP-UX
@@ -817,42 +1790,79 @@ static int pdc_model(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_cache(unsigned int *arg)
+
+/*
+ * Take the geometry of one cache from fw_cfg if qemu provides it.  The
+ * entries of the machine table stay the defaults.  The OS derives its
+ * flush stride from the configuration word as cc_line << (3 + cc_block),
+ * so cc_block is set to match the line size with cc_line kept at 2.
+ */
+static void pdc_cache_geometry(const char *name, unsigned long *size
+                               , struct pdc_cache_cf *conf
+                               , unsigned long *stride, unsigned long *count
+                               , unsigned long *loop)
+{
+    char file[32];
+    unsigned long csize, line, ways, block;
+
+    snprintf(file, sizeof(file), "opt/hppa/%s-size", name);
+    csize = romfile_loadint(file, *size);
+    snprintf(file, sizeof(file), "opt/hppa/%s-line", name);
+    line = romfile_loadint(file, *stride);
+    snprintf(file, sizeof(file), "opt/hppa/%s-ways", name);
+    ways = romfile_loadint(file, *loop);
+
+    if (csize == *size && line == *stride && ways == *loop)
+        return;
+    for (block = 0; block < 16 && (32UL << block) != line; block++)
+        ;
+    if (block == 16 || !ways || !csize || csize % (line * ways)) {
+        dprintf(1, "parisc: ignoring %s geometry from fw_cfg: %lu bytes,"
+                " %lu byte lines, %lu ways\n", name, csize, line, ways);
+        return;
+    }
+    *size = csize;
+    *stride = line;
+    *loop = ways;
+    *count = csize / (line * ways);
+    conf->cc_line = 2;
+    conf->cc_block = block;
+}
+
+/* Adjust the cache and TLB geometry once at boot, so that PDC_CACHE only
+ * reads it.  This runs after qemu_cfg_init(). */
+static void pdc_cache_setup(void)
+{
+    struct pdc_cache_info *ci = machine_cache_info;
+
+    BUG_ON(sizeof(cache_info) != sizeof(*machine_cache_info));
+    pdc_cache_geometry("icache", &ci->ic_size, &ci->ic_conf, &ci->ic_stride
+                       , &ci->ic_count, &ci->ic_loop);
+    pdc_cache_geometry("dcache", &ci->dc_size, &ci->dc_conf, &ci->dc_stride
+                       , &ci->dc_count, &ci->dc_loop);
+    // XXX: number of TLB entries should be aligned with qemu
+    machine_cache_info->it_size = 256;
+    machine_cache_info->dt_size = 256;
+    machine_cache_info->it_loop = 1;
+    machine_cache_info->dt_loop = 1;
+
+    /* The line sizes must be powers of 2 for the flush loops */
+    BUG_ON(machine_cache_info->dc_stride & (machine_cache_info->dc_stride-1));
+    BUG_ON(machine_cache_info->ic_stride & (machine_cache_info->ic_stride-1));
+
+    dprintf(1, "parisc: I-cache %ld KB, %ld byte lines, D-cache %ld KB,"
+            " %ld byte lines\n"
+            , machine_cache_info->ic_size / 1024, machine_cache_info->ic_stride
+            , machine_cache_info->dc_size / 1024, machine_cache_info->dc_stride);
+}
+
+static int pdc_cache(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
-    static unsigned long cache_info[] = { PARISC_PDC_CACHE_INFO };
-    static struct pdc_cache_info *machine_cache_info
-        = (struct pdc_cache_info *) &cache_info;
 
     switch (option) {
         case PDC_CACHE_INFO:
-            BUG_ON(sizeof(cache_info) != sizeof(*machine_cache_info));
-            // XXX: number of TLB entries should be aligned with qemu
-            machine_cache_info->it_size = 256;
-            machine_cache_info->dt_size = 256;
-            machine_cache_info->it_loop = 1;
-            machine_cache_info->dt_loop = 1;
-
-#if 0
-            dprintf(0, "\n\nCACHE  IC: %ld %ld %ld DC: %ld %ld %ld\n",
-                    machine_cache_info->ic_count, machine_cache_info->ic_loop, machine_cache_info->ic_stride,
-                    machine_cache_info->dc_count, machine_cache_info->dc_loop, machine_cache_info->dc_stride);
-#endif
-#if 1
-            /* Increase cc_block from 1 to 11. This increases icache_stride
-             * and dcache_stride to 32768 bytes. Revisit for HP-UX. */
-            machine_cache_info->dc_conf.cc_block = 11;
-            machine_cache_info->ic_conf.cc_block = 11;
-
-            machine_cache_info->ic_size = 0; /* no instruction cache */
-            machine_cache_info->ic_count = 0;
-            machine_cache_info->ic_loop = 0;
-            machine_cache_info->dc_size = 0; /* no data cache */
-            machine_cache_info->dc_count = 0;
-            machine_cache_info->dc_loop = 0;
-#endif
-
             memcpy(result, cache_info, sizeof(cache_info));
             return PDC_OK;
     }
@@ -860,15 +1870,15 @@ static int pdc_cache(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_hpa(unsigned int *arg)
+static int pdc_hpa(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
 
     switch (option) {
         case PDC_HPA_PROCESSOR:
-            result[0] = CPU_HPA; // XXX: NEED TO FIX FOR SMP?
-            result[1] = 0;       // XXX: for SMP: 0,1,2,3,4...(num of this cpu)
+            result[0] = cpu_hpa();
+            result[1] = cpu_index();
             return PDC_OK;
         case PDC_HPA_MODULES:
             return PDC_BAD_OPTION; // all modules on same board as the processor.
@@ -876,17 +1886,18 @@ static int pdc_hpa(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_coproc(unsigned int *arg)
+static int pdc_coproc(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
-    unsigned char mask;
+    unsigned long mask;
     switch (option) {
         case PDC_COPROC_CFG:
             memset(result, 0, 32 * sizeof(unsigned long));
-            mask = ~((1 << (8-smp_cpus))-1);
-            /* set bit per cpu in ccr_functional and ccr_present: */
-            mtctl(mask, 10); /* initialize cr10 */
+            /* The CCR describes the coprocessors of the calling CPU, which
+             * all have the floating-point unit in bits 0 and 1. */
+            mask = 0xc0;
+            mtctl(mask, 10); /* initialize cr10 of this CPU */
             result[0] = mask;
             result[1] = mask;
             result[17] = 1; // Revision
@@ -896,7 +1907,7 @@ static int pdc_coproc(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_iodc(unsigned int *arg)
+static int pdc_iodc(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -940,8 +1951,8 @@ static int pdc_iodc(unsigned int *arg)
             memcpy((void*) ARG5, &iodc_entry, *result);
             c = (unsigned char *) &iodc_entry_table;
             /* calculate offset into jump table. */
-            c += (ARG4 - PDC_IODC_RI_INIT) * 2 * sizeof(unsigned int);
-            memcpy((void*) ARG5, c, 2 * sizeof(unsigned int));
+            c += (ARG4 - PDC_IODC_RI_INIT) * LOAD_FW_SIZE;
+            memcpy((void*) ARG5, c, LOAD_FW_SIZE);
             // dprintf(0, "\n\nSeaBIOS: Info PDC_IODC function OK\n");
             flush_data_cache((char*)ARG5, *result);
             return PDC_OK;
@@ -960,10 +1971,11 @@ static int pdc_iodc(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_tod(unsigned int *arg)
+static int pdc_tod(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
+    int ret;
 
     switch (option) {
         case PDC_TOD_READ:
@@ -975,7 +1987,10 @@ static int pdc_tod(unsigned int *arg)
             if (ARG2 < SECONDS_2000_JAN_1)
                 return PDC_INVALID_ARG;
             /* we ignore the usecs in ARG3 */
-            return epoch_to_date_time(ARG2);
+            spin_lock(&pdc_tod_lock);
+            ret = epoch_to_date_time(ARG2);
+            spin_unlock(&pdc_tod_lock);
+            return ret;
         case 2: /* PDC_TOD_CALIBRATE_TIMERS */
             /* double-precision floating-point with frequency of Interval Timer in megahertz: */
             *(double*)&result[0] = (double)CPU_CLOCK_MHZ;
@@ -988,7 +2003,7 @@ static int pdc_tod(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_stable(unsigned int *arg)
+static int pdc_stable(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -998,12 +2013,17 @@ static int pdc_stable(unsigned int *arg)
         case PDC_STABLE_READ:
             if ((ARG2 + ARG4) > STABLE_STORAGE_SIZE)
                 return PDC_INVALID_ARG;
+            spin_lock(&pdc_storage_lock);
             memcpy((unsigned char *) ARG3, &stable_storage[ARG2], ARG4);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
         case PDC_STABLE_WRITE:
             if ((ARG2 + ARG4) > STABLE_STORAGE_SIZE)
                 return PDC_INVALID_ARG;
+            spin_lock(&pdc_storage_lock);
             memcpy(&stable_storage[ARG2], (unsigned char *) ARG3, ARG4);
+            storage_write(stable_file, stable_storage, ARG2, ARG4);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
         case PDC_STABLE_RETURN_SIZE:
             result[0] = STABLE_STORAGE_SIZE;
@@ -1011,13 +2031,16 @@ static int pdc_stable(unsigned int *arg)
         case PDC_STABLE_VERIFY_CONTENTS:
             return PDC_OK;
         case PDC_STABLE_INITIALIZE:
+            spin_lock(&pdc_storage_lock);
             init_stable_storage();
+            storage_write(stable_file, stable_storage, 0, STABLE_STORAGE_SIZE);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
     }
     return PDC_BAD_OPTION;
 }
 
-static int pdc_nvolatile(unsigned int *arg)
+static int pdc_nvolatile(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -1026,12 +2049,17 @@ static int pdc_nvolatile(unsigned int *arg)
         case PDC_NVOLATILE_READ:
             if ((ARG2 + ARG4) > NVOLATILE_STORAGE_SIZE)
                 return PDC_INVALID_ARG;
+            spin_lock(&pdc_storage_lock);
             memcpy((unsigned char *) ARG3, &nvolatile_storage[ARG2], ARG4);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
         case PDC_NVOLATILE_WRITE:
             if ((ARG2 + ARG4) > NVOLATILE_STORAGE_SIZE)
                 return PDC_INVALID_ARG;
+            spin_lock(&pdc_storage_lock);
             memcpy(&nvolatile_storage[ARG2], (unsigned char *) ARG3, ARG4);
+            storage_write(nvolatile_file, nvolatile_storage, ARG2, ARG4);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
         case PDC_NVOLATILE_RETURN_SIZE:
             result[0] = NVOLATILE_STORAGE_SIZE;
@@ -1039,13 +2067,17 @@ static int pdc_nvolatile(unsigned int *arg)
         case PDC_NVOLATILE_VERIFY_CONTENTS:
             return PDC_OK;
         case PDC_NVOLATILE_INITIALIZE:
+            spin_lock(&pdc_storage_lock);
             memset(nvolatile_storage, 0, sizeof(nvolatile_storage));
+            storage_write(nvolatile_file, nvolatile_storage, 0
+                          , NVOLATILE_STORAGE_SIZE);
+            spin_unlock(&pdc_storage_lock);
             return PDC_OK;
     }
     return PDC_BAD_OPTION;
 }
 
-static int pdc_add_valid(unsigned int *arg)
+static int pdc_add_valid(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
 
@@ -1065,7 +2097,88 @@ static int pdc_add_valid(unsigned int *arg)
     return PDC_REQ_ERR_0; /* Operation completed with a requestor bus error. */
 }
 
-static int pdc_tlb(unsigned int *arg)
+/*
+ * Block TLB entries and the hardware TLB miss handler live in the
+ * emulated CPU, which is handed the PDC arguments in %r26..%r19 with the
+ * "diag 0x100" instruction and returns the PDC status in %r28.  Emulators
+ * without support ignore the instruction, so %r28 keeps PDC_BAD_PROC and
+ * the OS sees neither feature.  The firmware validates the requests and
+ * keeps a per-CPU copy of what the OS has set up.
+ */
+#define BTLB_SLOTS      16
+
+static struct btlb_slot {
+    unsigned long virt_page_hi, virt_page;
+    unsigned long phys_page;
+    unsigned long len;          /* in pages, 0 if unused */
+    unsigned long entry_info;
+} btlb_cpu_slots[HPPA_MAX_CPUS][BTLB_SLOTS];
+
+static int pdc_cpu_diag(pdc_arg_t *arg)
+{
+    register unsigned long r26 asm("r26") = ARG0;
+    register unsigned long r25 asm("r25") = ARG1;
+    register unsigned long r24 asm("r24") = ARG2;
+    register unsigned long r23 asm("r23") = ARG3;
+    register unsigned long r22 asm("r22") = ARG4;
+    register unsigned long r21 asm("r21") = ARG5;
+    register unsigned long r20 asm("r20") = ARG6;
+    register unsigned long r19 asm("r19") = ARG7;
+    register long ret0 asm("r28") = PDC_BAD_PROC;
+
+    asm volatile("diag 0x100"
+                 : "+r" (ret0)
+                 : "r" (r26), "r" (r25), "r" (r24), "r" (r23),
+                   "r" (r22), "r" (r21), "r" (r20), "r" (r19)
+                 : "memory");
+    return ret0;
+}
+
+static int pdc_block_tlb(pdc_arg_t *arg)
+{
+    unsigned long option = ARG1;
+    struct btlb_slot *btlb_slots = btlb_cpu_slots[cpu_index()];
+    unsigned long slot;
+    int ret;
+
+    switch (option) {
+        case PDC_BTLB_INFO:
+            return pdc_cpu_diag(arg);
+        case PDC_BTLB_INSERT:
+            slot = ARG7;
+            if (slot >= BTLB_SLOTS || !ARG5)
+                return PDC_INVALID_ARG;
+            ret = pdc_cpu_diag(arg);
+            if (ret == PDC_OK) {
+                btlb_slots[slot].virt_page_hi = ARG2;
+                btlb_slots[slot].virt_page = ARG3;
+                btlb_slots[slot].phys_page = ARG4;
+                btlb_slots[slot].len = ARG5;
+                btlb_slots[slot].entry_info = ARG6;
+                dprintf(1, "parisc: BTLB slot %ld: virt 0x%lx:0x%lx phys 0x%lx"
+                        " %ld pages\n", slot, btlb_slots[slot].virt_page_hi
+                        , btlb_slots[slot].virt_page, btlb_slots[slot].phys_page
+                        , btlb_slots[slot].len);
+            }
+            return ret;
+        case PDC_BTLB_PURGE:
+            slot = ARG4;
+            if (slot >= BTLB_SLOTS)
+                return PDC_INVALID_ARG;
+            ret = pdc_cpu_diag(arg);
+            if (ret == PDC_OK)
+                btlb_slots[slot].len = 0;
+            return ret;
+        case PDC_BTLB_PURGE_ALL:
+            ret = pdc_cpu_diag(arg);
+            if (ret == PDC_OK)
+                memset(btlb_slots, 0, sizeof(btlb_cpu_slots[0]));
+            return ret;
+    }
+    return PDC_BAD_OPTION;
+}
+
+static int pdc_tlb(pdc_arg_t *arg)
 {
 #if 0
     /* still buggy, let's avoid it to keep things simple. */
@@ -1083,13 +2196,13 @@ static int pdc_tlb(unsigned int *arg)
     return PDC_BAD_PROC;
 }
 
-static int pdc_mem(unsigned int *arg)
+static int pdc_mem(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
 
     // only implemented on 64bit PDC!
-    if (sizeof(unsigned long) == sizeof(unsigned int))
+    if (!CONFIG_64BIT)
         return PDC_BAD_PROC;
 
     switch (option) {
@@ -1106,12 +2219,55 @@ static int pdc_mem(unsigned int *arg)
         case PDC_MEM_GOODMEM:
             GoldenMemory = ARG3;
             return PDC_OK;
+#if CONFIG_64BIT
+        case PDC_MEM_TABLE: {
+            struct pdc_memory_table_raddr *raddr = (void *)ARG2;
+            struct pdc_memory_table *table = (void *)ARG3;
+            unsigned long entries = ram_size_high ? 2 : 1;
+
+            raddr->entries_total = entries;
+            if (entries > ARG4)
+                entries = ARG4;
+            raddr->entries_returned = entries;
+            if (entries >= 1) {
+                table[0].paddr = 0;
+                table[0].pages = ram_size / PAGE_SIZE;
+                table[0].reserved = 0;
+            }
+            if (entries >= 2) {
+                table[1].paddr = RAM_HIGH_START;
+                table[1].pages = ram_size_high / PAGE_SIZE;
+                table[1].reserved = 0;
+            }
+            return PDC_OK;
+        }
+#endif
     }
     dprintf(0, "\n\nSeaBIOS: Check PDC_MEM option %ld ARG3=%x ARG4=%x ARG5=%x\n", option, ARG3, ARG4, ARG5);
     return PDC_BAD_PROC;
 }
 
-static int pdc_psw(unsigned int *arg)
+static int pdc_mem_map(pdc_arg_t *arg)
+{
+    unsigned long option = ARG1;
+    struct pdc_memory_map *memmap = (struct pdc_memory_map *)ARG2;
+    struct pdc_module_path *mod_path = (struct pdc_module_path *)ARG3;
+    hppa_device_t *dev;
+    unsigned long index;
+
+    switch (option) {
+        case PDC_MEM_MAP_HPA:
+            dev = find_hppa_device_by_path(mod_path, &index);
+            if (!dev)
+                return PDC_NE_MOD;
+            memmap->hpa = dev->hpa;
+            memmap->more_pgs = 0;
+            return PDC_OK;
+    }
+    return PDC_BAD_OPTION;
+}
+
+static int pdc_psw(pdc_arg_t *arg)
 {
     static unsigned long psw_defaults = PDC_PSW_ENDIAN_BIT;
     unsigned long option = ARG1;
@@ -1119,9 +2275,8 @@ static int pdc_psw(unsigned int *arg)
 
     if (option > PDC_PSW_SET_DEFAULTS)
         return PDC_BAD_OPTION;
-    /* FIXME: For 64bit support enable PDC_PSW_WIDE_BIT too! */
     if (option == PDC_PSW_MASK)
-        *result = PDC_PSW_ENDIAN_BIT;
+        *result = PDC_PSW_ENDIAN_BIT | (CONFIG_64BIT ? PDC_PSW_WIDE_BIT : 0);
     if (option == PDC_PSW_GET_DEFAULTS)
         *result = psw_defaults;
     if (option == PDC_PSW_SET_DEFAULTS) {
@@ -1130,7 +2285,7 @@ static int pdc_psw(unsigned int *arg)
     return PDC_OK;
 }
 
-static int pdc_system_map(unsigned int *arg)
+static int pdc_system_map(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -1176,7 +2331,7 @@ static int pdc_system_map(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_soft_power(unsigned int *arg)
+static int pdc_soft_power(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
 
@@ -1190,7 +2345,7 @@ static int pdc_soft_power(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_io(unsigned int *arg)
+static int pdc_io(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
 
@@ -1205,7 +2360,7 @@ static int pdc_io(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_pci_index(unsigned int *arg)
+static int pdc_pci_index(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -1234,7 +2389,7 @@ static int pdc_pci_index(unsigned int *arg)
     return PDC_BAD_OPTION;
 }
 
-static int pdc_initiator(unsigned int *arg)
+static int pdc_initiator(pdc_arg_t *arg)
 {
     unsigned long option = ARG1;
     unsigned long *result = (unsigned long *)ARG2;
@@ -1260,117 +2415,312 @@ static int pdc_initiator(unsigned int *arg)
 }
 
 
-int __VISIBLE parisc_pdc_entry(unsigned int *arg FUNC_MANY_ARGS)
+static int pdc_bad_proc(pdc_arg_t *arg)
 {
-    unsigned long proc = ARG0;
-    unsigned long option = ARG1;
-
-    if (pdc_debug) {
-        printf("\nSeaBIOS: Start PDC proc %s(%d) option %d result=0x%x ARG3=0x%x %s ",
-                pdc_name(ARG0), ARG0, ARG1, ARG2, ARG3, (proc == PDC_IODC)?hpa_name(ARG3):"");
-        printf("ARG4=0x%x ARG5=0x%x ARG6=0x%x ARG7=0x%x\n", ARG4, ARG5, ARG6, ARG7);
-    }
+    return PDC_BAD_PROC;
+}
 
-    switch (proc) {
-        case PDC_POW_FAIL:
-            break;
+static int pdc_crash_prep(pdc_arg_t *arg)
+{
+    /* This should actually quiesce all I/O and prepare the System for crash dumping.
+       Ignoring it for now, otherwise the BUG_ON below would quit qemu before we have
+       a chance to see the kernel panic */
+    return PDC_OK;
+}
 
-        case PDC_CHASSIS: /* chassis functions */
-            return pdc_chassis(arg);
+static int pdc_pat_probe(pdc_arg_t *arg)
+{
+    // Called by HP-UX 11 bootcd during boot. Probably checks PDC_PAT_CELL
+    // and PDC_PAT_CHASSIS_LOG (even if we are not PAT firmware)
+    dprintf(0, "\n\nSeaBIOS: UNKNOWN PDC proc %u OPTION %u called with ARG2=%x ARG3=%x ARG4=%x\n", ARG0, ARG1, ARG2, ARG3, ARG4);
+    return PDC_BAD_PROC;
+}
 
-        case PDC_PIM:
-            return pdc_pim(arg);
+static int pdc_broadcast_reset(pdc_arg_t *arg)
+{
+    dprintf(0, "\n\nSeaBIOS: PDC_BROADCAST_RESET (reset system) called with ARG3=%x ARG4=%x\n", ARG3, ARG4);
+    reset();
+    return PDC_OK;
+}
 
-        case PDC_MODEL: /* model information */
-            return pdc_model(arg);
+static int pdc_seabios_stats(pdc_arg_t *arg);
+
+/* PDC procedures, dispatched through pdc_proc_slot[] */
+static const struct pdc_proc_s {
+    unsigned long proc;
+    int (*func)(pdc_arg_t *arg);
+} pdc_procs[] = {
+    { PDC_CHASSIS,              pdc_chassis },
+    { PDC_PIM,                  pdc_pim },
+    { PDC_MODEL,                pdc_model },
+    { PDC_CACHE,                pdc_cache },
+    { PDC_HPA,                  pdc_hpa },
+    { PDC_COPROC,               pdc_coproc },
+    { PDC_IODC,                 pdc_iodc },
+    { PDC_TOD,                  pdc_tod },
+    { PDC_STABLE,               pdc_stable },
+    { PDC_NVOLATILE,            pdc_nvolatile },
+    { PDC_ADD_VALID,            pdc_add_valid },
+    { PDC_INSTR,                pdc_bad_proc },
+    { PDC_CONFIG,               pdc_bad_proc }, /* Obsolete */
+    { PDC_BLOCK_TLB,            pdc_block_tlb },
+    { PDC_TLB,                  pdc_tlb },
+    { PDC_MEM,                  pdc_mem },
+    { PDC_PSW,                  pdc_psw },
+    { PDC_SYSTEM_MAP,           pdc_system_map },
+    { PDC_SOFT_POWER,           pdc_soft_power },
+    { PDC_CRASH_PREP,           pdc_crash_prep },
+    { PDC_SCSI_PARMS,           pdc_bad_proc },
+    { 64,                       pdc_pat_probe },
+    { 65,                       pdc_pat_probe },
+    { PDC_IO,                   pdc_io },
+    { PDC_BROADCAST_RESET,      pdc_broadcast_reset },
+    { PDC_PCI_INDEX,            pdc_pci_index },
+    { PDC_RELOCATE,             pdc_bad_proc }, /* We don't want to relocate any firmware. */
+    { PDC_INITIATOR,            pdc_initiator },
+    { PDC_MEM_MAP,              pdc_mem_map },
+    { PDC_SEABIOS_STATS,        pdc_seabios_stats },
+};
 
-        case PDC_CACHE:
-            return pdc_cache(arg);
+#define PDC_MAX_PROC            (PDC_LINK + 1)
+#define PDC_STAT_OPTIONS        4       /* last one counts all higher options */
+#define PDC_STAT_UNKNOWN        ARRAY_SIZE(pdc_procs)
 
-        case PDC_HPA:
-            return pdc_hpa(arg);
+/* index+1 into pdc_procs[] for the low proc numbers, 0 if unimplemented */
+static u8 pdc_proc_slot[PDC_MAX_PROC];
 
-        case PDC_COPROC:
-            return pdc_coproc(arg);
+static struct pdc_stat_s pdc_stats[ARRAY_SIZE(pdc_procs) + 1][PDC_STAT_OPTIONS];
 
-        case PDC_IODC: /* Call IODC functions */
-            return pdc_iodc(arg);
+static void pdc_dispatch_setup(void)
+{
+    int i;
 
-        case PDC_TOD:	/* Time of day */
-            return pdc_tod(arg);
+    for (i = 0; i < ARRAY_SIZE(pdc_procs); i++)
+        if (pdc_procs[i].proc < PDC_MAX_PROC)
+            pdc_proc_slot[pdc_procs[i].proc] = i + 1;
+}
 
-        case PDC_STABLE:
-            return pdc_stable(arg);
+static int pdc_find_slot(unsigned long proc)
+{
+    int i;
 
-        case PDC_NVOLATILE:
-            return pdc_nvolatile(arg);
+    if (proc < PDC_MAX_PROC)
+        return pdc_proc_slot[proc] - 1;
+    for (i = 0; i < ARRAY_SIZE(pdc_procs); i++)
+        if (pdc_procs[i].proc == proc)
+            return i;
+    return -1;
+}
 
-        case PDC_ADD_VALID:
-            return pdc_add_valid(arg);
+static void pdc_show_stats(void)
+{
+    int i, opt;
+
+    printf("PDC call statistics (cycles of interval timer):\n");
+    for (i = 0; i <= ARRAY_SIZE(pdc_procs); i++)
+        for (opt = 0; opt < PDC_STAT_OPTIONS; opt++) {
+            struct pdc_stat_s *st = &pdc_stats[i][opt];
+            if (!st->calls)
+                continue;
+            printf("  %s option %d%s: %d calls, %llu cycles, avg %llu, max %d\n"
+                    , (i < ARRAY_SIZE(pdc_procs)) ? pdc_name(pdc_procs[i].proc) : "unknown"
+                    , opt, (opt == PDC_STAT_OPTIONS-1) ? "+" : ""
+                    , st->calls, st->cycles, st->cycles / st->calls
+                    , st->max_cycles);
+        }
+    for (i = 0; i < IODC_ENTRIES; i++)
+        for (opt = 0; opt < IODC_STAT_OPTIONS; opt++) {
+            struct pdc_stat_s *st = &iodc_stats[i][opt];
+            if (!st->calls)
+                continue;
+            printf("  IODC %s option %d%s: %d calls, %llu cycles, avg %llu, max %d\n"
+                    , iodc_entry_names[i]
+                    , opt, (opt == IODC_STAT_OPTIONS-1) ? "+" : ""
+                    , st->calls, st->cycles, st->cycles / st->calls
+                    , st->max_cycles);
+        }
+}
 
-        case PDC_INSTR:
-            return PDC_BAD_PROC;
+/*
+ * Boot phase profiler.  Each milestone stores the interval timer when a
+ * phase of the firmware startup ends.  The ring keeps the latest
+ * BOOT_MILESTONES entries.  If qemu provides the writable fw_cfg file
+ * BOOT_PROFILE_FILE, the whole structure (big-endian) is written to it
+ * after each milestone.  The guest finds it through
+ * PDC_SEABIOS_STATS_BOOTPROF.
+ */
+#define BOOT_MILESTONES         64
+#define BOOT_PROFILE_MAGIC      0x42505246      /* "BPRF" */
+#define BOOT_PROFILE_FILE       "opt/hppa/boot-profile"
+
+struct boot_profile {
+    u32 magic;
+    u32 count;          /* milestones recorded, including overwritten ones */
+    u32 timer_khz;      /* interval timer frequency */
+    u32 reserved;
+    struct boot_milestone {
+        char name[24];
+        u64 stamp;      /* interval timer cycles */
+    } ring[BOOT_MILESTONES];
+};
 
-        case PDC_CONFIG:	/* Obsolete */
-            return PDC_BAD_PROC;
+struct boot_profile __VISIBLE boot_profile = {
+    .magic = BOOT_PROFILE_MAGIC,
+    .timer_khz = CPU_CLOCK_MHZ * 1000,
+};
 
-        case PDC_BLOCK_TLB:	/* not needed on virtual machine */
-            return PDC_BAD_PROC;
+void boot_milestone(const char *name)
+{
+    static struct romfile_s *file;
+    struct boot_milestone *m;
+
+    m = &boot_profile.ring[boot_profile.count++ % BOOT_MILESTONES];
+    m->stamp = timer_read64();
+    strtcpy(m->name, name, sizeof(m->name));
+
+    /* fw_cfg files are known once qemu_cfg_init() has run */
+    if (!file)
+        file = romfile_find(BOOT_PROFILE_FILE);
+    if (file && qemu_cfg_dma_enabled() && file->size >= sizeof(boot_profile))
+        qemu_cfg_write_file(&boot_profile, file, 0, sizeof(boot_profile));
+}
 
-        case PDC_TLB:		/* hardware TLB not used on Linux, but on HP-UX (if available) */
-            return pdc_tlb(arg);
+static void boot_profile_show(void)
+{
+    u32 i, first = 0;
+    u64 start, prev;
 
-        case PDC_MEM:
-            return pdc_mem(arg);
+    if (!boot_profile.count)
+        return;
+    if (boot_profile.count > BOOT_MILESTONES)
+        first = boot_profile.count - BOOT_MILESTONES;
+    start = prev = boot_profile.ring[first % BOOT_MILESTONES].stamp;
+    dprintf(1, "Boot phases (elapsed time, duration of phase):\n");
+    for (i = first; i < boot_profile.count; i++) {
+        struct boot_milestone *m = &boot_profile.ring[i % BOOT_MILESTONES];
+        dprintf(1, "  %s: %u us, %u us\n", m->name
+                , (u32)timer_ticks_to_us(m->stamp - start)
+                , (u32)timer_ticks_to_us(m->stamp - prev));
+        prev = m->stamp;
+    }
+}
 
-        case PDC_PSW:	/* Get/Set default System Mask  */
-            return pdc_psw(arg);
+/* Show all statistics of the firmware */
+static void parisc_show_stats(void)
+{
+    int i;
 
-        case PDC_SYSTEM_MAP:
-            return pdc_system_map(arg);
+    boot_profile_show();
+    pdc_show_stats();
+    bcache_show_stats();
+    malloc_show_stats();
+    pollwait_show_stats();
+    ata_show_stats();
+    for (i = 0; i < HPPA_MAX_CPUS; i++)
+        if (smp_wakeups[i])
+            printf("CPU %d woke up %d times while parked.\n"
+                    , i, smp_wakeups[i]);
+}
 
-        case PDC_SOFT_POWER: // don't have a soft-power switch
-            return pdc_soft_power(arg);
+/* firmware private procedure to read the PDC call statistics */
+static int pdc_seabios_stats(pdc_arg_t *arg)
+{
+    unsigned long option = ARG1;
+    unsigned long *result = (unsigned long *)ARG2;
+    struct pdc_stat_entry *entry = (void *)ARG3;
+    unsigned long count = ARG4 / sizeof(*entry);
+    int i, opt;
 
-        case PDC_CRASH_PREP:
-            /* This should actually quiesce all I/O and prepare the System for crash dumping.
-               Ignoring it for now, otherwise the BUG_ON below would quit qemu before we have
-               a chance to see the kernel panic */
+    switch (option) {
+        case PDC_SEABIOS_STATS_INFO:
+            result[0] = ARRAY_SIZE(pdc_stats) * PDC_STAT_OPTIONS
+                + IODC_ENTRIES * IODC_STAT_OPTIONS;
+            result[1] = sizeof(*entry);
             return PDC_OK;
-
-        case 26: // PDC_SCSI_PARMS is the architected firmware interface to replace the Hversion PDC_INITIATOR procedure.
-            return PDC_BAD_PROC;
-
-        case 64: // Called by HP-UX 11 bootcd during boot. Probably checks PDC_PAT_CELL (even if we are not PAT firmware)
-        case 65: // Called by HP-UX 11 bootcd during boot. Probably checks PDC_PAT_CHASSIS_LOG (even if we are not PAT firmware)
-            dprintf(0, "\n\nSeaBIOS: UNKNOWN PDC proc %lu OPTION %lu called with ARG2=%x ARG3=%x ARG4=%x\n", proc, option, ARG2, ARG3, ARG4);
-            return PDC_BAD_PROC;
-
-        case PDC_IO:
-            return pdc_io(arg);
-
-        case PDC_BROADCAST_RESET:
-            dprintf(0, "\n\nSeaBIOS: PDC_BROADCAST_RESET (reset system) called with ARG3=%x ARG4=%x\n", ARG3, ARG4);
-            reset();
+        case PDC_SEABIOS_STATS_READ:
+            result[0] = 0;
+            for (i = 0; i < ARRAY_SIZE(pdc_stats); i++)
+                for (opt = 0; opt < PDC_STAT_OPTIONS; opt++) {
+                    struct pdc_stat_s *st = &pdc_stats[i][opt];
+                    if (!st->calls)
+                        continue;
+                    if (result[0] >= count)
+                        return PDC_OK;
+                    entry->proc = (i < ARRAY_SIZE(pdc_procs)) ? pdc_procs[i].proc : -1;
+                    entry->option = opt;
+                    entry->calls = st->calls;
+                    entry->max_cycles = st->max_cycles;
+                    entry->cycles = st->cycles;
+                    entry++;
+                    result[0]++;
+                }
+            for (i = 0; i < IODC_ENTRIES; i++)
+                for (opt = 0; opt < IODC_STAT_OPTIONS; opt++) {
+                    struct pdc_stat_s *st = &iodc_stats[i][opt];
+                    if (!st->calls)
+                        continue;
+                    if (result[0] >= count)
+                        return PDC_OK;
+                    entry->proc = PDC_SEABIOS_STATS_IODC + i;
+                    entry->option = opt;
+                    entry->calls = st->calls;
+                    entry->max_cycles = st->max_cycles;
+                    entry->cycles = st->cycles;
+                    entry++;
+                    result[0]++;
+                }
+            return PDC_OK;
+        case PDC_SEABIOS_STATS_PRINT:
+            parisc_show_stats();
+            return PDC_OK;
+        case PDC_SEABIOS_STATS_RESET:
+            memset(pdc_stats, 0, sizeof(pdc_stats));
+            memset(iodc_stats, 0, sizeof(iodc_stats));
             return PDC_OK;
+        case PDC_SEABIOS_STATS_BOOTPROF:
+            result[0] = (unsigned long)&boot_profile;
+            result[1] = sizeof(boot_profile);
+            return PDC_OK;
+    }
+    return PDC_BAD_OPTION;
+}
 
-        case PDC_PCI_INDEX:
-            return pdc_pci_index(arg);
+int __VISIBLE parisc_pdc_entry(pdc_arg_t *arg FUNC_MANY_ARGS)
+{
+    unsigned long proc = ARG0;
+    unsigned long option = ARG1;
+    unsigned long start, cycles;
+    struct pdc_stat_s *st;
+    int slot, ret;
+
+    if (pdc_debug) {
+        printf("\nSeaBIOS: Start PDC proc %s(%d) option %d result=0x%x ARG3=0x%x %s ",
+                pdc_name(ARG0), ARG0, ARG1, ARG2, ARG3, (proc == PDC_IODC)?hpa_name(ARG3):"");
+        printf("ARG4=0x%x ARG5=0x%x ARG6=0x%x ARG7=0x%x\n", ARG4, ARG5, ARG6, ARG7);
+    }
 
-       case PDC_RELOCATE:
-            /* We don't want to relocate any firmware. */
-            return PDC_BAD_PROC;
+    slot = pdc_find_slot(proc);
+    st = &pdc_stats[(slot < 0) ? PDC_STAT_UNKNOWN : slot]
+                   [(option < PDC_STAT_OPTIONS) ? option : PDC_STAT_OPTIONS-1];
+    if (slot < 0) {
+        st->calls++;
+        printf("\n** WARNING **: SeaBIOS: Unimplemented PDC proc %s(%d) option %d result=%x ARG3=%x ",
+                pdc_name(ARG0), ARG0, ARG1, ARG2, ARG3);
+        printf("ARG4=%x ARG5=%x ARG6=%x ARG7=%x\n", ARG4, ARG5, ARG6, ARG7);
 
-        case PDC_INITIATOR:
-            return pdc_initiator(arg);
+        BUG_ON(pdc_debug);
+        return PDC_BAD_PROC;
     }
 
-    printf("\n** WARNING **: SeaBIOS: Unimplemented PDC proc %s(%d) option %d result=%x ARG3=%x ",
-            pdc_name(ARG0), ARG0, ARG1, ARG2, ARG3);
-    printf("ARG4=%x ARG5=%x ARG6=%x ARG7=%x\n", ARG4, ARG5, ARG6, ARG7);
+    start = rdtscll();
+    if (NARROW_CALL)
+        ret = narrow_call(pdc_procs[slot].func, arg, &ARG2);
+    else
+        ret = pdc_procs[slot].func(arg);
+    cycles = rdtscll() - start;
 
-    BUG_ON(pdc_debug);
-    return PDC_BAD_PROC;
+    pdc_stat_add(st, cycles);
+    return ret;
 }
 
 
@@ -1383,11 +2733,10 @@ extern void find_initial_parisc_boot_drives(
         struct drive_s **cdrom);
 extern struct drive_s *select_parisc_boot_drive(char bootdrive);
 
-static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
-        char bootdrive)
+/* Read the boot block of a drive into target.  Returns 0 on success. */
+static int read_boot_block(struct drive_s *drive, unsigned int *target)
 {
     int ret;
-    unsigned int *target = (void *)(PAGE0->mem_free + 32*1024);
     struct disk_op_s disk_op = {
         .buf_fl = target,
         .command = CMD_SEEK,
@@ -1395,24 +2744,17 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
         .lba = 0,
     };
 
-    boot_drive = select_parisc_boot_drive(bootdrive);
-    disk_op.drive_fl = boot_drive;
-    if (boot_drive == NULL) {
-        printf("SeaBIOS: No boot device.\n");
-        return 0;
-    }
-
     /* seek to beginning of disc/CD */
-    disk_op.drive_fl = boot_drive;
+    disk_op.drive_fl = drive;
     ret = process_op(&disk_op);
     // printf("DISK_SEEK returned %d\n", ret);
     if (ret)
-        return 0;
+        return ret;
 
-    // printf("Boot disc type is 0x%x\n", boot_drive->type);
-    disk_op.drive_fl = boot_drive;
-    if (boot_drive->type == DTYPE_ATA_ATAPI ||
-            boot_drive->type == DTYPE_ATA) {
+    // printf("Boot disc type is 0x%x\n", drive->type);
+    disk_op.drive_fl = drive;
+    if (drive->type == DTYPE_ATA_ATAPI ||
+            drive->type == DTYPE_ATA) {
         disk_op.command = CMD_ISREADY;
         ret = process_op(&disk_op);
     } else {
@@ -1421,7 +2763,7 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
     // printf("DISK_READY returned %d\n", ret);
 
     /* read boot sector of disc/CD */
-    disk_op.drive_fl = boot_drive;
+    disk_op.drive_fl = drive;
     disk_op.buf_fl = target;
     disk_op.command = CMD_READ;
     disk_op.count = (FW_BLOCKSIZE / disk_op.drive_fl->blksize);
@@ -1429,7 +2771,23 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
     // printf("blocksize is %d, count is %d\n", disk_op.drive_fl->blksize, disk_op.count);
     ret = process_op(&disk_op);
     // printf("DISK_READ(count=%d) = %d\n", disk_op.count, ret);
-    if (ret)
+    return ret;
+}
+
+static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
+        char bootdrive)
+{
+    int ret;
+    unsigned int *target = (void *)(unsigned long)(PAGE0->mem_free + 32*1024);
+    struct disk_op_s disk_op;
+
+    boot_drive = select_parisc_boot_drive(bootdrive);
+    if (boot_drive == NULL) {
+        printf("SeaBIOS: No boot device.\n");
+        return 0;
+    }
+
+    if (read_boot_block(boot_drive, target))
         return 0;
 
     unsigned int ipl_addr = be32_to_cpu(target[0xf0/sizeof(int)]); /* offset 0xf0 in bootblock */
@@ -1448,6 +2806,7 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
     // IPL_ENTRY-  Word aligned, less than IPL_SIZE
 
     /* seek to beginning of IPL */
+    memset(&disk_op, 0, sizeof(disk_op));
     disk_op.drive_fl = boot_drive;
     disk_op.command = CMD_SEEK;
     disk_op.count = 0; // (ipl_size / disk_op.drive_fl->blksize);
@@ -1463,6 +2822,9 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
     disk_op.lba = (ipl_addr / disk_op.drive_fl->blksize);
     ret = process_op(&disk_op);
     // printf("DISK_READ IPL returned %d\n", ret);
+    if (ret)
+        return 0;
+    flush_data_cache((char*)target, ipl_size);
 
     // printf("First word at %p is 0x%x\n", target, target[0]);
 
@@ -1475,26 +2837,61 @@ static int parisc_boot_menu(unsigned long *iplstart, unsigned long *iplend,
 }
 
 
+/*
+ * Fast boot: set up only the LUN of the primary boot path saved in stable
+ * storage and check that it holds a LIF boot block.  Returns NULL if the
+ * path is unknown or not bootable, and the caller scans all devices.
+ */
+static struct drive_s *fast_boot_probe(void)
+{
+    struct pdc_module_path *path = (void *)stable_storage;
+    unsigned int *target = (void *)(unsigned long)(PAGE0->mem_free + 32*1024);
+    struct pci_device *pci;
+    struct drive_s *drive = NULL;
+
+    if (!stable_loaded)
+        return NULL;
+    /* only paths to the emulated SCSI drives can be probed directly */
+    if (path->path.flags != mod_path_emulated_drives.path.flags
+            || path->path.mod != mod_path_emulated_drives.path.mod
+            || memcmp(path->path.bc, mod_path_emulated_drives.path.bc, 5))
+        return NULL;
+
+    foreachpci(pci)
+        if (pci->vendor == PCI_VENDOR_ID_LSI_LOGIC
+                && ((pci->bdf >> 3) & 0x0f) == path->path.bc[5]) {
+            drive = lsi_scsi_probe_lun(pci, path->layers[0], path->layers[1]);
+            break;
+        }
+    if (!drive)
+        return NULL;
+
+    if (read_boot_block(drive, target) || (target[0]>>16) != 0x8000) {
+        printf("Saved boot path FWSCSI.%d.%d not bootable, searching devices.\n",
+                path->layers[0], path->layers[1]);
+        return NULL;
+    }
+    return drive;
+}
+
+
 /********************************************************
  * FIRMWARE MAIN ENTRY POINT
  ********************************************************/
 
 static const struct pz_device mem_cons_boot = {
     .hpa = DINO_UART_HPA,
-    .iodc_io = (unsigned long) &iodc_entry,
     .cl_class = CL_DUPLEX,
 };
 
 static const struct pz_device mem_boot_boot = {
     .dp.flags = PF_AUTOBOOT,
     .hpa = IDE_HPA, // DINO_SCSI_HPA,  // IDE_HPA
-    .iodc_io = (unsigned long) &iodc_entry,
     .cl_class = CL_RANDOM,
 };
 
 static const struct pz_device mem_kbd_boot = {
     .hpa = DINO_UART_HPA,
-    .iodc_io = (unsigned long) &iodc_entry,
     .cl_class = CL_KEYBD,
 };
 
@@ -1563,6 +2960,28 @@ static void parisc_vga_init(void)
 }
 
 /* Prepare boot paths in PAGE0 and stable memory */
+/* Save 'path' at 'offset' in stable storage, unless it is stored already */
+static void stable_path_update(unsigned int offset
+                               , const struct pdc_module_path *path)
+{
+    if (!memcmp(&stable_storage[offset], path, sizeof(*path)))
+        return;
+    memcpy(&stable_storage[offset], path, sizeof(*path));
+    storage_write(stable_file, stable_storage, offset, sizeof(*path));
+}
+
+/* Save the path of the emulated 'drive' as primary or alternate boot path */
+static void stable_boot_path_update(unsigned int offset, struct drive_s *drive)
+{
+    struct pdc_module_path path = mod_path_emulated_drives;
+
+    if (drive) {
+        path.layers[0] = drive->target;
+        path.layers[1] = drive->lun;
+    }
+    stable_path_update(offset, &path);
+}
+
 static void prepare_boot_path(volatile struct pz_device *dest,
         const struct pz_device *source,
         unsigned int stable_offset)
@@ -1586,9 +3005,13 @@ static void prepare_boot_path(volatile struct pz_device *dest,
     /* copy device path to entry in PAGE0 */
     memcpy((void*)dest, source, sizeof(*source));
     memcpy((void*)&dest->dp, mod_path, sizeof(struct device_path));
+    /* PAGE0 holds 32-bit addresses, set at runtime for the wide firmware */
+    dest->iodc_io = (unsigned long) &iodc_entry;
 
-    /* copy device path to stable storage */
-    memcpy(&stable_storage[stable_offset], mod_path, sizeof(*mod_path));
+    /* default console and keyboard paths, the boot paths are set up by
+     * the caller */
+    if (!stable_loaded && !HPA_is_storage_device(hpa))
+        stable_path_update(stable_offset, mod_path);
 
     BUG_ON(sizeof(*mod_path) != 0x20);
     BUG_ON(sizeof(struct device_path) != 0x20);
@@ -1603,14 +3026,25 @@ void __VISIBLE start_parisc_firmware(void)
     unsigned long interactive = (linux_kernel_entry == 1) ? 1:0;
     char bootdrive = (char)cmdline; // c = hdd, d = CD/DVD
 
+    boot_milestone("start");
+
     if (smp_cpus > HPPA_MAX_CPUS)
         smp_cpus = HPPA_MAX_CPUS;
 
-    if (ram_size >= FIRMWARE_START)
+    /* The I/O space starts at FIRMWARE_START.  The 64-bit firmware reports
+     * the RAM above it at RAM_HIGH_START through PDC_MEM_TABLE. */
+    if (ram_size >= FIRMWARE_START) {
+        if (CONFIG_64BIT)
+            ram_size_high = ram_size - FIRMWARE_START;
         ram_size = FIRMWARE_START;
+    }
+
+    pdc_dispatch_setup();
 
     /* Initialize device list */
     remove_parisc_devices(smp_cpus);
+    if (CONFIG_PARISC_SELFTEST)
+        dev_index_bench();
 
     /* Show list of HPA devices which are still returned by firmware. */
     if (0) { for (i=0; parisc_devices[i].hpa; i++)
@@ -1621,8 +3055,8 @@ void __VISIBLE start_parisc_firmware(void)
     memset((void*)PAGE0, 0, sizeof(*PAGE0));
 
     /* copy pdc_entry entry into low memory. */
-    memcpy((void*)MEM_PDC_ENTRY, &pdc_entry_table, 3*4);
-    flush_data_cache((char*)MEM_PDC_ENTRY, 3*4);
+    memcpy((void*)MEM_PDC_ENTRY, &pdc_entry_table, PDC_ENTRY_TABLE_SIZE);
+    flush_data_cache((char*)MEM_PDC_ENTRY, PDC_ENTRY_TABLE_SIZE);
 
     PAGE0->memc_cont = ram_size;
     PAGE0->memc_phsize = ram_size;
@@ -1632,6 +3066,7 @@ void __VISIBLE start_parisc_firmware(void)
     PAGE0->mem_hpa = CPU_HPA; // HPA of boot-CPU
     PAGE0->mem_pdc = MEM_PDC_ENTRY;
     PAGE0->mem_10msec = CPU_CLOCK_MHZ*(1000000ULL/100);
+    timer_setup();
 
     BUG_ON(PAGE0->mem_free <= MEM_PDC_ENTRY);
     BUG_ON(smp_cpus < 1 || smp_cpus > HPPA_MAX_CPUS);
@@ -1644,12 +3079,11 @@ void __VISIBLE start_parisc_firmware(void)
     PAGE0->imm_spa_size = ram_size;
     PAGE0->imm_max_mem = ram_size;
 
-    // Initialize stable storage
-    init_stable_storage();
 
     chassis_code = 0;
 
     malloc_preinit();
+    boot_milestone("malloc_preinit");
 
     // set Qemu serial debug port
     DebugOutputPort = PORT_SERIAL1;
@@ -1658,7 +3092,7 @@ void __VISIBLE start_parisc_firmware(void)
     cpu_hz = 100 * PAGE0->mem_10msec; /* Hz of this PARISC */
     dprintf(1, "\nPARISC SeaBIOS Firmware, %ld x PA7300LC (PCX-L2) at %d.%06d MHz, %lu MB RAM.\n",
             smp_cpus, cpu_hz / 1000000, cpu_hz % 1000000,
-            ram_size/1024/1024);
+            (ram_size + ram_size_high)/1024/1024);
 
     if (ram_size < MIN_RAM_SIZE) {
         printf("\nSeaBIOS: Machine configured with too little "
@@ -1670,18 +3104,40 @@ void __VISIBLE start_parisc_firmware(void)
     // handle_post();
     serial_debug_preinit();
     debug_banner();
+    if (CONFIG_PARISC_SELFTEST)
+        pa_string_test();
     // maininit();
     qemu_preinit();
     RamSize = ram_size;
     // coreboot_preinit();
+    qemu_cfg_init();
+    boot_milestone("qemu_preinit");
+
+    pdc_cache_setup();
+
+    /* string functions copy in steps of the data cache line stride */
+    parisc_dcache_stride = machine_cache_info->dc_stride;
+
+    // Initialize stable and non-volatile storage
+    storage_setup();
 
     pci_setup();
+    boot_milestone("pci_setup");
 
     serial_setup();
-    block_setup();
+    thread_setup();
+    boot_milestone("serial_setup");
+    /* with a valid saved primary path skip the full device scan */
+    if (!linux_kernel_entry && bootdrive == 'c' && fast_boot_probe())
+        boot_milestone("fast boot probe");
+    else {
+        parisc_full_scan();
+        boot_milestone("block_setup threads");
+    }
 
     // We don't have VGA BIOS, so init now.
     parisc_vga_init();
+    boot_milestone("parisc_vga_init");
 
     printf("\n");
     printf("Firmware Version 6.1\n"
@@ -1701,17 +3157,22 @@ void __VISIBLE start_parisc_firmware(void)
     printf("\n\n");
     printf("  Available memory:     %llu MB\n"
             "  Good memory required: %d MB\n\n",
-            (unsigned long long)ram_size/1024/1024, MIN_RAM_SIZE/1024/1024);
+            (unsigned long long)(ram_size + ram_size_high)/1024/1024,
+            MIN_RAM_SIZE/1024/1024);
 
     // search boot devices
     find_initial_parisc_boot_drives(&parisc_boot_harddisc, &parisc_boot_cdrom);
-
-    printf("  Primary boot path:    FWSCSI.%d.%d\n"
-            "  Alternate boot path:  FWSCSI.%d.%d\n"
-            "  Console path:         SERIAL_1.9600.8.none\n"
-            "  Keyboard path:        PS2\n\n",
-            parisc_boot_harddisc->target, parisc_boot_harddisc->lun,
-            parisc_boot_cdrom->target, parisc_boot_cdrom->lun);
+    boot_milestone("find_boot_drives");
+    boot_profile_show();
+
+    if (parisc_boot_harddisc)
+        printf("  Primary boot path:    FWSCSI.%d.%d\n",
+                parisc_boot_harddisc->target, parisc_boot_harddisc->lun);
+    if (parisc_boot_cdrom)
+        printf("  Alternate boot path:  FWSCSI.%d.%d\n",
+                parisc_boot_cdrom->target, parisc_boot_cdrom->lun);
+    printf("  Console path:         SERIAL_1.9600.8.none\n"
+            "  Keyboard path:        PS2\n\n");
 
     if (bootdrive == 'c')
         boot_drive = parisc_boot_harddisc;
@@ -1732,11 +3193,11 @@ void __VISIBLE start_parisc_firmware(void)
     prepare_boot_path(&(PAGE0->mem_cons), &mem_cons_boot, 0x60);
     prepare_boot_path(&(PAGE0->mem_boot), &mem_boot_boot, 0x0);
     prepare_boot_path(&(PAGE0->mem_kbd),  &mem_kbd_boot, 0xa0);
-    // copy primary boot path to alt boot path
-    memcpy(&stable_storage[0x80], &stable_storage[0], 0x20);
-    if (parisc_boot_cdrom) {
-        stable_storage[0x80 + 11] = parisc_boot_cdrom->target;
-        stable_storage[0x80 + 12] = parisc_boot_cdrom->lun;
+    // default primary and alternate boot path, the booted one is refreshed
+    // when booting
+    if (!stable_loaded) {
+        stable_boot_path_update(0x0, parisc_boot_harddisc);
+        stable_boot_path_update(0x80, parisc_boot_cdrom);
     }
     // currently booted path == CD in PAGE0->mem_boot
     if (boot_drive) {
@@ -1744,6 +3205,19 @@ void __VISIBLE start_parisc_firmware(void)
         PAGE0->mem_boot.dp.layers[1] = boot_drive->lun;
     }
 
+    bcache_setup();
+    ra_setup();
+    if (CONFIG_PARISC_SELFTEST)
+        ata_pio_bench(parisc_boot_harddisc);
+
+    for (i = 1; i < smp_cpus; i++)
+        if (smp_wakeups[i])
+            dprintf(1, "CPU %d woke up %d times while parked.\n"
+                    , i, smp_wakeups[i]);
+
+    thread_teardown();
+    malloc_prepboot();
+
     /* directly start Linux kernel if it was given on qemu command line. */
     if (linux_kernel_entry > 1) {
         void (*start_kernel)(unsigned long mem_free, unsigned long cline,
@@ -1751,6 +3225,9 @@ void __VISIBLE start_parisc_firmware(void)
 
         printf("Autobooting Linux kernel which was loaded by qemu...\n\n");
         start_kernel = (void *) linux_kernel_entry;
+        boot_milestone("start kernel");
+        /* the kernel image was written behind the caches */
+        flush_cache_all();
         start_kernel(PAGE0->mem_free, cmdline, initrd_start, initrd_end);
         hlt(); /* this ends the emulator */
     }
@@ -1778,11 +3255,16 @@ void __VISIBLE start_parisc_firmware(void)
 
         PAGE0->mem_boot.dp.layers[0] = boot_drive->target;
         PAGE0->mem_boot.dp.layers[1] = boot_drive->lun;
+        /* the saved primary or alternate path follows the device booted */
+        stable_boot_path_update(
+                boot_drive->blksize == CDROM_SECTOR_SIZE ? 0x80 : 0x0
+                , boot_drive);
 
         printf("\nBooting...\n"
                 "Boot IO Dependent Code (IODC) revision 153\n\n"
                 "%s Booted.\n", PAGE0->imm_soft_boot ? "SOFT":"HARD");
         start_ipl = (void *) iplstart;
+        boot_milestone("start IPL");
         start_ipl(interactive, iplend);
     }
 
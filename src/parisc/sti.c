@@ -7,6 +7,7 @@
 #include "autoconf.h"
 #include "types.h"
 #include "std/optionrom.h"
+#include "bregs.h" // struct bregs
 #include "hw/pci.h" // pci_config_readl
 #include "hw/pci_regs.h" // PCI_BASE_ADDRESS_0
 #include "vgahw.h"
@@ -30,7 +31,7 @@ struct pci_data __VISIBLE rom_pci_data = {
 
 extern void handle_100e(struct bregs *regs);
 
-void parisc_teletype_output(struct bregs *regs)
+static void parisc_vga_refresh_bars(void)
 {
 	// re-read PCI addresses. Linux kernel reconfigures those at boot.
 	parisc_vga_mem = pci_config_readl(VgaBDF, PCI_BASE_ADDRESS_0);
@@ -38,7 +39,30 @@ void parisc_teletype_output(struct bregs *regs)
 	VBE_framebuffer = parisc_vga_mem;
 	parisc_vga_mmio = pci_config_readl(VgaBDF, PCI_BASE_ADDRESS_2);
 	parisc_vga_mmio &= PCI_BASE_ADDRESS_MEM_MASK;
+}
 
+void parisc_teletype_output(struct bregs *regs)
+{
+	parisc_vga_refresh_bars();
 	handle_100e(regs);
 }
 
+// Write a whole buffer, re-reading the PCI BARs only once.
+void parisc_teletype_write(const char *s, int len)
+{
+	struct bregs br;
+
+	parisc_vga_refresh_bars();
+	br.flags = F_IF;
+	br.ah = 0x0e;
+	br.bl = 0x07;
+	while (len--) {
+		if (*s == '\n') {
+			br.al = '\r';
+			handle_100e(&br);
+		}
+		br.al = *s++;
+		handle_100e(&br);
+	}
+}
+
@@ -44,7 +44,7 @@
 #define sti_font_x(sti) (PTR_STI(sti->font)->width)
 #define sti_font_y(sti) (PTR_STI(sti->font)->height)
 
-#ifdef CONFIG_64BIT
+#if CONFIG_64BIT
 #define STI_LOWMEM	(GFP_KERNEL | GFP_DMA)
 #else
 #define STI_LOWMEM	(GFP_KERNEL)
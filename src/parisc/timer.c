@@ -5,16 +5,41 @@
 // This file may be distributed under the terms of the GNU LGPLv3 license.
 
 #include "config.h" // CONFIG_*
-#include "x86.h" // rdtscll()
+#include "output.h" // parisc_serial_poll
+#include "x86.h" // rdtscll(), spin_lock()
 #include "util.h" // timer_setup
 #include "parisc/pdc.h"
+#include "stacks.h" // yield
 
 #define PAGE0 ((volatile struct zeropage *) 0UL)
 
+/*
+ * The interval timer (cr16) counts CPU cycles and is extended to a 64-bit
+ * timebase below.  Conversions from and to time units multiply with
+ * fixed-point factors which timer_setup() derives from PAGE0->mem_10msec.
+ */
+#define TIMER_US_SHIFT  20      // us -> ticks
+#define TIMER_NS_SHIFT  30      // ns -> ticks
+#define TIMER_INV_SHIFT 24      // ticks -> us
+#define TIMER_MS_SHIFT  40      // ticks -> ms
+
+static u32 TimerKHz;
+static u64 TimerUsMult, TimerNsMult, TimerInvUsMult, TimerInvMsMult;
+
 // Setup internal timers.
 void
 timer_setup(void)
 {
+    u32 khz = PAGE0->mem_10msec / 10;
+
+    if (!khz)
+        return;
+    TimerKHz = khz;
+    TimerUsMult = ((u64)khz << TIMER_US_SHIFT) / 1000;
+    TimerNsMult = ((u64)khz << TIMER_NS_SHIFT) / 1000000;
+    TimerInvUsMult = (1000ULL << TIMER_INV_SHIFT) / khz;
+    TimerInvMsMult = (1ULL << TIMER_MS_SHIFT) / khz;
+    dprintf(3, "timer: %u kHz\n", khz);
 }
 
 void
@@ -22,30 +47,108 @@ pmtimer_setup(u16 ioport)
 {
 }
 
-// Return the number of milliseconds in 'ticks' number of timer irqs.
-u32 ticks_to_ms(u32 ticks)
+
+/****************************************************************
+ * 64-bit timebase
+ ****************************************************************/
+
+u32 TimerLast VARLOW;
+
+#if CONFIG_64BIT
+u64
+timer_read64(void)
+{
+    return rdtscll();
+}
+#else
+static u32 TimerHigh;
+static spinlock_t TimerLock = SPIN_LOCK_UNLOCKED;
+
+// cr16 is 32 bits wide and wraps after 17 seconds at 250 MHz.  Count
+// the wraps, which needs a read at least once per wrap period while a
+// deadline is pending; all wait loops read it continuously.
+u64
+timer_read64(void)
 {
-    return (10 * ticks / PAGE0->mem_10msec);
+    u32 now, high;
+
+    spin_lock(&TimerLock);
+    now = rdtscll();
+    if (now < TimerLast)
+        TimerHigh++;
+    TimerLast = now;
+    high = TimerHigh;
+    spin_unlock(&TimerLock);
+    return ((u64)high << 32) | now;
 }
+#endif
 
+u64 timer_ns_to_ticks(u32 ns)
+{
+    return ((u64)ns * TimerNsMult) >> TIMER_NS_SHIFT;
+}
 
-u32 ticks_from_ms(u32 ms)
+u64 timer_us_to_ticks(u32 us)
+{
+    return ((u64)us * TimerUsMult) >> TIMER_US_SHIFT;
+}
+
+u64 timer_ms_to_ticks(u32 ms)
+{
+    return (u64)ms * TimerKHz;
+}
+
+// Valid for intervals below 12 days at 250 MHz.
+u64 timer_ticks_to_us(u64 ticks)
 {
-    return (ms * PAGE0->mem_10msec / 10);
+    return (ticks * TimerInvUsMult) >> TIMER_INV_SHIFT;
+}
+
+u64 timer_deadline_us(u32 us)
+{
+    return timer_read64() + timer_us_to_ticks(us);
+}
+
+u64 timer_deadline_ms(u32 ms)
+{
+    return timer_read64() + timer_ms_to_ticks(ms);
+}
+
+// Check if the current time is past a deadline.
+int
+timer_expired(u64 deadline)
+{
+    return (s64)(timer_read64() - deadline) > 0;
 }
 
 
 /****************************************************************
- * Internal timer reading
+ * 32-bit timer interface of the drivers
  ****************************************************************/
 
-u32 TimerLast VARLOW;
+// The drivers keep 32-bit timestamps.  They count in units of
+// 2^TIMER_SHIFT cycles, so that timer_check() stays wrap-safe for
+// timeouts of up to 35 minutes at 250 MHz.
+#define TIMER_SHIFT     8
+
+// Return the number of milliseconds in 'ticks' timer_read() units.
+u32 ticks_to_ms(u32 ticks)
+{
+    return (((u64)ticks << TIMER_SHIFT) * TimerInvMsMult) >> TIMER_MS_SHIFT;
+}
+
+// Return the number of timer_read() units in 'ms' milliseconds.
+u32 ticks_from_ms(u32 ms)
+{
+    u64 ticks = timer_ms_to_ticks(ms) >> TIMER_SHIFT;
+    return ticks > 0xffffffff ? 0xffffffff : ticks;
+}
 
 // Sample the current timer value.
 static u32
 timer_read(void)
 {
-    return rdtscll();
+    return timer_read64() >> TIMER_SHIFT;
 }
 
 // Check if the current time is past a previously calculated end time.
@@ -56,44 +159,55 @@ timer_check(u32 end)
 }
 
 static void
-timer_sleep(u32 diff)
+timer_sleep(u64 diff)
 {
-    u32 start = timer_read();
-    u32 end = start + diff;
-    while (!timer_check(end))
+    u64 end = timer_read64() + diff;
+    while (!timer_expired(end))
         /* idle wait */;
 }
 
 void ndelay(u32 count) {
-    timer_sleep((count * PAGE0->mem_10msec / 10) / 1000 / 1000);
+    timer_sleep(timer_ns_to_ticks(count));
 }
 void udelay(u32 count) {
-    timer_sleep((count * PAGE0->mem_10msec / 10) / 1000);
+    timer_sleep(timer_us_to_ticks(count));
 }
 void mdelay(u32 count) {
-    timer_sleep((count * PAGE0->mem_10msec / 10));
+    timer_sleep(timer_ms_to_ticks(count));
+}
+
+// Wait until 'end', letting other threads run meanwhile.  Keep the
+// serial console receive FIFO from overflowing during long sleeps.
+static void
+timer_sleep_yield(u64 diff)
+{
+    u64 end = timer_read64() + diff;
+    while (!timer_expired(end)) {
+        parisc_serial_poll();
+        yield();
+    }
 }
 
 void nsleep(u32 count) {
-    ndelay(count);
+    timer_sleep_yield(timer_ns_to_ticks(count));
 }
 void usleep(u32 count) {
-    udelay(count);
+    timer_sleep_yield(timer_us_to_ticks(count));
 }
 void msleep(u32 count) {
-    mdelay(count);
+    timer_sleep_yield(timer_ms_to_ticks(count));
 }
 
-// Return the TSC value that is 'msecs' time in the future.
+// Return the timer value that is 'msecs' time in the future.
 u32
 timer_calc(u32 msecs)
 {
-    return (msecs * PAGE0->mem_10msec / 10) + timer_read();
+    return timer_read() + (u32)(timer_ms_to_ticks(msecs) >> TIMER_SHIFT);
 }
 u32
 timer_calc_usec(u32 usecs)
 {
-    return ((usecs * PAGE0->mem_10msec / 10) / 1000) + timer_read();
+    return timer_read() + (u32)(timer_us_to_ticks(usecs) >> TIMER_SHIFT);
 }
 
 
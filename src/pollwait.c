@@ -0,0 +1,47 @@
+// Statistics of the adaptive driver polling.
+//
+// This file may be distributed under the terms of the GNU LGPLv3 license.
+
+#include "output.h" // dprintf
+#include "pollwait.h" // struct pollwait_stats
+#include "x86.h" // __fls
+
+static struct pollwait_stats *PollwaitStats;
+
+// Account a completed (or timed out) wait in the histogram of a driver.
+void
+pollwait_record(struct pollwait_stats *stats, u32 polls, int timeout)
+{
+    ASSERT32FLAT();
+    if (!stats)
+        return;
+    if (!stats->registered) {
+        stats->registered = 1;
+        stats->next = PollwaitStats;
+        PollwaitStats = stats;
+    }
+    if (timeout) {
+        stats->timeouts++;
+        return;
+    }
+    u32 bucket = polls ? __fls(polls) + 1 : 0;
+    if (bucket >= POLLWAIT_BUCKETS)
+        bucket = POLLWAIT_BUCKETS - 1;
+    stats->hist[bucket]++;
+}
+
+// Print the histograms: bucket n counts waits of 2^(n-1) to 2^n-1 polls.
+void
+pollwait_show_stats(void)
+{
+    struct pollwait_stats *stats;
+    int i;
+    for (stats = PollwaitStats; stats; stats = stats->next) {
+        dprintf(1, "pollwait %s: timeouts=%u polls", stats->name
+                , stats->timeouts);
+        for (i = 0; i < POLLWAIT_BUCKETS; i++)
+            if (stats->hist[i])
+                dprintf(1, " <%u:%u", 1 << i, stats->hist[i]);
+        dprintf(1, "\n");
+    }
+}
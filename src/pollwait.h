@@ -0,0 +1,71 @@
+// Adaptive polling for driver completion loops.
+#ifndef __POLLWAIT_H
+#define __POLLWAIT_H
+
+#include "config.h" // MODESEGMENT
+#include "types.h" // u32
+#include "util.h" // usleep
+
+#define POLLWAIT_SPIN           16      // polls before the first sleep
+#define POLLWAIT_MAX_USEC       512     // upper bound of the back-off
+#define POLLWAIT_BUCKETS        16      // log2 histogram of polls
+
+// Polls needed until completion, collected per driver.
+struct pollwait_stats {
+    const char *name;
+    u32 hist[POLLWAIT_BUCKETS];
+    u32 timeouts;
+    struct pollwait_stats *next;
+    int registered;
+};
+
+#define DECLARE_POLLWAIT_STATS(var, drvname)    \
+    static struct pollwait_stats var = { .name = drvname }
+
+struct pollwait_s {
+    struct pollwait_stats *stats;
+    u32 polls;
+    u32 delay;
+};
+
+// pollwait.c
+void pollwait_record(struct pollwait_stats *stats, u32 polls, int timeout);
+void pollwait_show_stats(void);
+
+static inline void
+pollwait_init(struct pollwait_s *pw, struct pollwait_stats *stats)
+{
+    // The statistics are only kept in 32bit flat mode.
+    pw->stats = MODESEGMENT ? NULL : stats;
+    pw->polls = 0;
+    pw->delay = 1;
+}
+
+// Wait before polling the device again.  Emulated devices usually
+// complete within a few polls, so poll tightly first and then back off
+// exponentially for slow media.
+static inline void
+pollwait_step(struct pollwait_s *pw)
+{
+    if (++pw->polls <= POLLWAIT_SPIN)
+        return;
+    usleep(pw->delay);
+    if (pw->delay < POLLWAIT_MAX_USEC)
+        pw->delay <<= 1;
+}
+
+static inline void
+pollwait_done(struct pollwait_s *pw)
+{
+    if (!MODESEGMENT)
+        pollwait_record(pw->stats, pw->polls, 0);
+}
+
+static inline void
+pollwait_timeout(struct pollwait_s *pw)
+{
+    if (!MODESEGMENT)
+        pollwait_record(pw->stats, pw->polls, 1);
+}
+
+#endif // pollwait.h
@@ -7,6 +7,8 @@
 #include "stacks.h" // yield
 #include "string.h" // memcpy
 #include "farptr.h" // SET_SEG
+#include "output.h" // dprintf
+#include "util.h" // timer_read64
 
 
 /****************************************************************
@@ -70,17 +72,264 @@ strcmp(const char *s1, const char *s2)
     }
 }
 
+#if CONFIG_PARISC
+/****************************************************************
+ * PA-RISC word and cache line wide string engine
+ ****************************************************************/
+
+// Data cache line stride.  Defaults to the dc_stride of
+// PARISC_PDC_CACHE_INFO and gets updated by the firmware at startup.
+unsigned long parisc_dcache_stride = 32;
+
+#define PA_WSIZE        sizeof(unsigned long)
+#define PA_WMASK        (PA_WSIZE - 1)
+#define PA_ALIGNED(p)   (!((unsigned long)(p) & PA_WMASK))
+
+#ifdef __LP64__
+#define PA_LDM          "ldd,ma 8"
+#define PA_STM          "std,ma"
+#define PA_LDMB         "ldd,mb -8"
+#define PA_STMB         "std,mb"
+#define PA_WS           "8"
+#define PA_NWS          "-8"
+#else
+#define PA_LDM          "ldw,ma 4"
+#define PA_STM          "stw,ma"
+#define PA_LDMB         "ldw,mb -4"
+#define PA_STMB         "stw,mb"
+#define PA_WS           "4"
+#define PA_NWS          "-4"
+#endif
+
+// Copy 8 words forward, using post-modify loads and stores.
+static inline void
+pa_copy8(unsigned long **dp, const unsigned long **sp)
+{
+    unsigned long *d = *dp;
+    const unsigned long *s = *sp;
+    unsigned long t0, t1, t2, t3;
+    asm volatile(
+        PA_LDM "(%4),%0\n\t"
+        PA_LDM "(%4),%1\n\t"
+        PA_LDM "(%4),%2\n\t"
+        PA_LDM "(%4),%3\n\t"
+        PA_STM " %0," PA_WS "(%5)\n\t"
+        PA_STM " %1," PA_WS "(%5)\n\t"
+        PA_STM " %2," PA_WS "(%5)\n\t"
+        PA_STM " %3," PA_WS "(%5)\n\t"
+        PA_LDM "(%4),%0\n\t"
+        PA_LDM "(%4),%1\n\t"
+        PA_LDM "(%4),%2\n\t"
+        PA_LDM "(%4),%3\n\t"
+        PA_STM " %0," PA_WS "(%5)\n\t"
+        PA_STM " %1," PA_WS "(%5)\n\t"
+        PA_STM " %2," PA_WS "(%5)\n\t"
+        PA_STM " %3," PA_WS "(%5)"
+        : "=&r" (t0), "=&r" (t1), "=&r" (t2), "=&r" (t3), "+r" (s), "+r" (d)
+        : : "memory");
+    *dp = d;
+    *sp = s;
+}
+
+// Copy 8 words backward, using pre-modify loads and stores.
+static inline void
+pa_copy8_back(unsigned long **dp, const unsigned long **sp)
+{
+    unsigned long *d = *dp;
+    const unsigned long *s = *sp;
+    unsigned long t0, t1, t2, t3;
+    asm volatile(
+        PA_LDMB "(%4),%0\n\t"
+        PA_LDMB "(%4),%1\n\t"
+        PA_LDMB "(%4),%2\n\t"
+        PA_LDMB "(%4),%3\n\t"
+        PA_STMB " %0," PA_NWS "(%5)\n\t"
+        PA_STMB " %1," PA_NWS "(%5)\n\t"
+        PA_STMB " %2," PA_NWS "(%5)\n\t"
+        PA_STMB " %3," PA_NWS "(%5)\n\t"
+        PA_LDMB "(%4),%0\n\t"
+        PA_LDMB "(%4),%1\n\t"
+        PA_LDMB "(%4),%2\n\t"
+        PA_LDMB "(%4),%3\n\t"
+        PA_STMB " %0," PA_NWS "(%5)\n\t"
+        PA_STMB " %1," PA_NWS "(%5)\n\t"
+        PA_STMB " %2," PA_NWS "(%5)\n\t"
+        PA_STMB " %3," PA_NWS "(%5)"
+        : "=&r" (t0), "=&r" (t1), "=&r" (t2), "=&r" (t3), "+r" (s), "+r" (d)
+        : : "memory");
+    *dp = d;
+    *sp = s;
+}
+
+// Store 8 copies of 'val', using post-modify stores.
+static inline unsigned long *
+pa_set8(unsigned long *d, unsigned long val)
+{
+    asm volatile(
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)\n\t"
+        PA_STM " %1," PA_WS "(%0)"
+        : "+r" (d) : "r" (val) : "memory");
+    return d;
+}
+
+// Touch the source cache line which will be needed next.  A load to
+// %r0 is a prefetch hint on PA2.0 and a harmless load on PA1.1.
+static inline void
+pa_prefetch(const void *p)
+{
+    asm volatile("ldw 0(%0),%%r0" : : "r" (p));
+}
+
+// Forward copy of word aligned source and destination.
+static void
+pa_copy_words(unsigned long *d, const unsigned long *s, size_t words)
+{
+    unsigned long line = parisc_dcache_stride;
+
+    // Cache line path: copy whole lines and prefetch the following one.
+    if (line >= 8*PA_WSIZE && !(line & (8*PA_WSIZE-1))
+        && words * PA_WSIZE >= 2*line) {
+        unsigned long blocks = line / (8*PA_WSIZE);
+        while (words * PA_WSIZE >= 2*line) {
+            unsigned long i;
+            pa_prefetch((const char *)s + line);
+            for (i = 0; i < blocks; i++)
+                pa_copy8(&d, &s);
+            words -= line / PA_WSIZE;
+        }
+    }
+    while (words >= 8) {
+        pa_copy8(&d, &s);
+        words -= 8;
+    }
+    while (words--)
+        *d++ = *s++;
+}
+
+// Forward copy to a word aligned destination from a source which is
+// not word aligned.  Every aligned source word read contains at least
+// one byte of the source area, so no access goes past its bounds.
+static void
+pa_copy_words_shifted(unsigned long *d, const char *s, size_t words)
+{
+    unsigned long off = (unsigned long)s & PA_WMASK;
+    const unsigned long *sw = (const void *)(s - off);
+    unsigned int ls = 8 * off, rs = 8 * (PA_WSIZE - off);
+    unsigned long prev = *sw++;
+
+    while (words--) {
+        unsigned long next = *sw++;
+        *d++ = (prev << ls) | (next >> rs);
+        prev = next;
+    }
+}
+
+static void *
+pa_memcpy(void *d1, const void *s1, size_t len)
+{
+    char *d = d1;
+    const char *s = s1;
+
+    if (len >= 2*PA_WSIZE) {
+        // Align the destination, the source follows if possible.
+        while (!PA_ALIGNED(d)) {
+            *d++ = *s++;
+            len--;
+        }
+        size_t words = len / PA_WSIZE;
+        if (PA_ALIGNED(s))
+            pa_copy_words((void *)d, (const void *)s, words);
+        else
+            pa_copy_words_shifted((void *)d, s, words);
+        d += words * PA_WSIZE;
+        s += words * PA_WSIZE;
+        len &= PA_WMASK;
+    }
+    while (len--)
+        *d++ = *s++;
+    return d1;
+}
+
+static void *
+pa_memmove_back(void *d1, const void *s1, size_t len)
+{
+    char *d = d1 + len;
+    const char *s = s1 + len;
+
+    if (len >= 2*PA_WSIZE
+        && !(((unsigned long)d ^ (unsigned long)s) & PA_WMASK)) {
+        while (!PA_ALIGNED(d)) {
+            *--d = *--s;
+            len--;
+        }
+        unsigned long *dw = (void *)d;
+        const unsigned long *sw = (const void *)s;
+        size_t words = len / PA_WSIZE;
+        while (words >= 8) {
+            pa_copy8_back(&dw, &sw);
+            words -= 8;
+        }
+        while (words--)
+            *--dw = *--sw;
+        d = (void *)dw;
+        s = (const void *)sw;
+        len &= PA_WMASK;
+    }
+    while (len--)
+        *--d = *--s;
+    return d1;
+}
+
+static void *
+pa_memset(void *s, int c, size_t n)
+{
+    char *d = s;
+
+    if (n >= 2*PA_WSIZE) {
+        unsigned long val = (u8)c;
+        val |= val << 8;
+        val |= val << 16;
+#ifdef __LP64__
+        val |= val << 32;
+#endif
+        while (!PA_ALIGNED(d)) {
+            *d++ = c;
+            n--;
+        }
+        unsigned long *dw = (void *)d;
+        size_t words = n / PA_WSIZE;
+        while (words >= 8) {
+            dw = pa_set8(dw, val);
+            words -= 8;
+        }
+        while (words--)
+            *dw++ = val;
+        d = (void *)dw;
+        n &= PA_WMASK;
+    }
+    while (n--)
+        *d++ = c;
+    return s;
+}
+#endif
+
 inline void
 memset_far(u16 d_seg, void *d_far, u8 c, size_t len)
 {
-	d_far = MAKE_FLATPTR(d_seg, (u32)d_far);
+	d_far = MAKE_FLATPTR(d_seg, (unsigned long)d_far);
 	memset(d_far, c, len);
 }
 
 inline void
 memset16_far(u16 d_seg, void *s, u16 c, size_t n)
 {
-    s = MAKE_FLATPTR(d_seg, (u32)s);
+    s = MAKE_FLATPTR(d_seg, (unsigned long)s);
     while (n)
         ((u16 *)s)[--n] = c;
 }
@@ -88,9 +337,13 @@ memset16_far(u16 d_seg, void *s, u16 c, size_t n)
 void *
 memset(void *s, int c, size_t n)
 {
+#if CONFIG_PARISC
+    return pa_memset(s, c, n);
+#else
     while (n)
         ((char *)s)[--n] = c;
     return s;
+#endif
 }
 
 void memset_fl(void *ptr, u8 val, size_t size)
@@ -101,12 +354,16 @@ void memset_fl(void *ptr, u8 val, size_t size)
 inline void
 memcpy_far(u16 d_seg, void *d, u16 s_seg, const void *s, size_t n)
 {
-    d = MAKE_FLATPTR(d_seg, (u32)d);
-    s = MAKE_FLATPTR(s_seg, (u32)s);
+    d = MAKE_FLATPTR(d_seg, (unsigned long)d);
+    s = MAKE_FLATPTR(s_seg, (unsigned long)s);
+#if CONFIG_PARISC
+    pa_memcpy(d, s, n);
+#else
     while (n) {
 	--n;
 	((char *)d)[n] = ((char *)s)[n];
     }
+#endif
 }
 
 inline void
@@ -135,6 +392,9 @@ memmove(void *d, const void *s, size_t len)
     if (s >= d)
         return memcpy(d, s, len);
 
+#if CONFIG_PARISC
+    return pa_memmove_back(d, s, len);
+#else
     d += len-1;
     s += len-1;
     while (len--) {
@@ -144,6 +404,7 @@ memmove(void *d, const void *s, size_t len)
     }
 
     return d;
+#endif
 }
 
 // Copy a string - truncating it if necessary.
@@ -179,3 +440,152 @@ nullTrailingSpace(char *buf)
         buf++;
     return buf;
 }
+
+#if CONFIG_PARISC_SELFTEST
+/****************************************************************
+ * PA-RISC string engine self test and benchmark
+ ****************************************************************/
+
+#define ST_TEST_SIZE    1024
+#define ST_BENCH_SIZE   4096
+#define ST_GUARD        16
+#define ST_ITER_SHIFT   6
+// keep gcc from turning the reference byte loops into memcpy/memset calls
+#define ST_NO_LIBCALL   __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+static u8 st_src[ST_BENCH_SIZE], st_dst[ST_BENCH_SIZE];
+static u8 st_ref[ST_TEST_SIZE], st_tmp[ST_TEST_SIZE];
+
+// Lengths around the word, unroll and cache line boundaries.
+static const u16 st_lens[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+    127, 128, 129, 255, 256, 257, 511, 700
+};
+
+static void
+st_fill(u8 *p, u8 seed)
+{
+    int i;
+    for (i = 0; i < ST_TEST_SIZE; i++)
+        p[i] = seed + i * 7 + (i >> 8);
+}
+
+static int
+st_check(const char *what, int doff, int soff, int len)
+{
+    int i;
+    for (i = 0; i < ST_TEST_SIZE; i++)
+        if (st_dst[i] != st_ref[i]) {
+            dprintf(1, "string test: %s dst+%d src+%d len %d"
+                    " differs at byte %d\n", what, doff, soff, len, i);
+            return 1;
+        }
+    return 0;
+}
+
+// Compare memcpy, memset and memmove against byte loops for all
+// source/destination alignments, the lengths above and overlapping
+// areas in both directions.  The guard bytes around the destination
+// must stay untouched.
+static int ST_NO_LIBCALL
+st_test(void)
+{
+    int doff, soff, l, i, errors = 0;
+
+    st_fill(st_src, 0x11);
+    for (doff = 0; doff < 2*PA_WSIZE; doff++)
+        for (soff = 0; soff < 2*PA_WSIZE; soff++)
+            for (l = 0; l < ARRAY_SIZE(st_lens); l++) {
+                int len = st_lens[l];
+                st_fill(st_dst, 0x55);
+                st_fill(st_ref, 0x55);
+                for (i = 0; i < len; i++)
+                    st_ref[ST_GUARD+doff+i] = st_src[ST_GUARD+soff+i];
+                memcpy(&st_dst[ST_GUARD+doff], &st_src[ST_GUARD+soff], len);
+                errors += st_check("memcpy", doff, soff, len);
+            }
+
+    for (doff = 0; doff < 2*PA_WSIZE; doff++)
+        for (l = 0; l < ARRAY_SIZE(st_lens); l++) {
+            int len = st_lens[l];
+            u8 c = 0xa0 + len;
+            st_fill(st_dst, 0x55);
+            st_fill(st_ref, 0x55);
+            for (i = 0; i < len; i++)
+                st_ref[ST_GUARD+doff+i] = c;
+            memset(&st_dst[ST_GUARD+doff], c, len);
+            errors += st_check("memset", doff, 0, len);
+        }
+
+    for (doff = 0; doff < 2*PA_WSIZE+4; doff++)
+        for (soff = 0; soff < 2*PA_WSIZE+4; soff++)
+            for (l = 0; l < ARRAY_SIZE(st_lens); l++) {
+                int len = st_lens[l];
+                st_fill(st_dst, 0x33);
+                st_fill(st_ref, 0x33);
+                for (i = 0; i < len; i++)
+                    st_tmp[i] = st_ref[ST_GUARD+soff+i];
+                for (i = 0; i < len; i++)
+                    st_ref[ST_GUARD+doff+i] = st_tmp[i];
+                memmove(&st_dst[ST_GUARD+doff], &st_dst[ST_GUARD+soff], len);
+                errors += st_check("memmove", doff, soff, len);
+            }
+
+    return errors;
+}
+
+// The byte loop which memcpy used before, as the benchmark baseline.
+static void noinline ST_NO_LIBCALL
+st_bytecopy(u8 *d, const u8 *s, size_t n)
+{
+    while (n) {
+        --n;
+        d[n] = s[n];
+    }
+}
+
+static void
+st_bench(int doff, int soff, int len)
+{
+    u64 start, bytes, words, fill;
+    int i;
+
+    start = timer_read64();
+    for (i = 0; i < 1 << ST_ITER_SHIFT; i++)
+        st_bytecopy(&st_dst[doff], &st_src[soff], len);
+    bytes = (timer_read64() - start) >> ST_ITER_SHIFT;
+
+    start = timer_read64();
+    for (i = 0; i < 1 << ST_ITER_SHIFT; i++)
+        memcpy(&st_dst[doff], &st_src[soff], len);
+    words = (timer_read64() - start) >> ST_ITER_SHIFT;
+
+    start = timer_read64();
+    for (i = 0; i < 1 << ST_ITER_SHIFT; i++)
+        memset(&st_dst[doff], i, len);
+    fill = (timer_read64() - start) >> ST_ITER_SHIFT;
+
+    dprintf(1, "  %4d bytes dst+%d src+%d: byte loop %llu, memcpy %llu,"
+            " memset %llu cycles\n", len, doff, soff, bytes, words, fill);
+}
+
+// Check the string engine and print cycles per call of the byte loop,
+// memcpy and memset for the sizes of PDC buffers, FW_BLOCKSIZE boot
+// reads and larger IPL and framebuffer copies.
+void
+pa_string_test(void)
+{
+    static const u16 sizes[] = { 64, 512, 2048, ST_BENCH_SIZE - 8 };
+    int errors, i;
+
+    dprintf(1, "string test: line stride %lu bytes\n", parisc_dcache_stride);
+    errors = st_test();
+    dprintf(1, "string test: %s (%d errors)\n", errors ? "FAILED" : "passed"
+            , errors);
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        st_bench(0, 0, sizes[i]);
+        st_bench(0, 3, sizes[i]);
+    }
+}
+#endif
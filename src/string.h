@@ -5,6 +5,7 @@
 #include "types.h" // u32
 
 // string.c
+extern unsigned long parisc_dcache_stride;
 u8 checksum_far(u16 buf_seg, void *buf_far, u32 len);
 u8 checksum(void *buf, u32 len);
 size_t strlen(const char *s);
@@ -27,5 +28,6 @@ void *memmove(void *d, const void *s, size_t len);
 char *strtcpy(char *dest, const char *src, size_t len);
 char *strchr(const char *s, int c);
 char *nullTrailingSpace(char *buf);
+void pa_string_test(void);
 
 #endif // string.h
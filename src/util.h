@@ -176,6 +176,20 @@ u32 ticks_to_ms(u32 ticks);
 u32 ticks_from_ms(u32 ms);
 void pit_setup(void);
 
+// parisc/parisc.c
+void boot_milestone(const char *name);
+void flush_data_cache(char *start, size_t length);
+
+// parisc/timer.c
+u64 timer_read64(void);
+u64 timer_ns_to_ticks(u32 ns);
+u64 timer_us_to_ticks(u32 us);
+u64 timer_ms_to_ticks(u32 ms);
+u64 timer_ticks_to_us(u64 ticks);
+u64 timer_deadline_us(u32 us);
+u64 timer_deadline_ms(u32 ms);
+int timer_expired(u64 deadline);
+
 // jpeg.c
 struct jpeg_decdata *jpeg_alloc(void);
 int jpeg_decode(struct jpeg_decdata *jpeg, unsigned char *buf);